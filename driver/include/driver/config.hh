@@ -2,10 +2,46 @@
 
 #include <string>
 
+#include "geom/dispatch.hh"
+#include "geom/narrow_phase.hh"
+
 namespace cmd {
 
+enum class Precision {
+  kFloat,
+  kDouble,
+  kMixed,  // float storage, near-touching pairs decided in double
+};
+
 struct Config {
   bool draw = false;
+  bool sequence = false;
+  bool components = false;
+  std::string input;            // file, empty means standard input
+  unsigned threads = 1;         // 0 means all hardware threads
+  unsigned time_budget_ms = 0;  // 0 means unlimited
+  geometry::NarrowPhase narrow_phase = geometry::kDefaultNarrowPhase;
+  geometry::simd::Isa isa = geometry::simd::bestIsa();  // of vector kernels
+  Precision precision = Precision::kFloat;
+  bool integer = false;  // coordinates must be 32-bit integers
+  bool mesh = false;     // equal vertices are shared, contact there is fine
+  bool indexed = false;  // vertex pool and faces on input, implies mesh
+  double snap = 0;       // grid step of near-duplicates, 0 means equal only
+  bool segments = false;   // print intersection segments of pairs
+  bool polylines = false;  // print segments welded into polylines
+  bool binary = false;     // segments and polylines in binary format
+
+  bool pipeline = false;          // broad and narrow phase on own threads
+  unsigned broad_threads = 1;     // --threads go to narrow phase
+  std::size_t batch_size = 1024;  // candidate pairs in one batch
+  std::size_t queue_depth = 64;   // batches waiting for narrow phase
+
+  bool out_of_core = false;
+  std::size_t memory_budget_mb = 1024;
+  std::string tmp_dir;  // empty means system temporary directory
+
+  unsigned workers = 1;  // processes
+  bool shard_worker = false;
 };
 
 }  // namespace cmd
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "geom/triangle3d.hh"
+
+namespace input {
+
+/**
+ * Whole file mapped read-only into memory.
+ */
+class MappedFile final {
+ public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view data() const noexcept { return {data_, size_}; }
+
+ private:
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+/**
+ * Parses text of triangles, their count followed by nine coordinates each,
+ * on given number of threads, 0 means all hardware threads. Text is cut at
+ * line breaks into chunks. Tokens of every chunk are counted first, then
+ * chunks parse their numbers straight into place of the array sized by the
+ * count. Throws if the count is missing or does not match the triangles.
+ */
+void parseTriangles(std::string_view text, unsigned threads,
+                    std::vector<geometry::Triangle3D<float>>& triangles);
+void parseTriangles(std::string_view text, unsigned threads,
+                    std::vector<geometry::Triangle3D<double>>& triangles);
+
+}  // namespace input
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+
+#include "driver/text_reader.hh"
+#include "geom/narrow_phase.hh"
+
+namespace ooc {
+
+struct Options {
+  std::size_t memory_budget = std::size_t{1} << 30;  // bytes
+  std::filesystem::path tmp_dir = std::filesystem::temp_directory_path();
+  unsigned threads = 1;
+  geometry::NarrowPhase narrow_phase = geometry::kDefaultNarrowPhase;
+};
+
+/**
+ * Finds intersecting triangles of the input which does not fit into memory.
+ *
+ * Input is streamed once and spread over bucket files by hashing cells of
+ * uniform grid, triangle crossing several cells is duplicated into every
+ * bucket it touches. Two intersecting triangles share a point, so they meet
+ * in the bucket of the cell containing that point. Buckets larger than the
+ * budget are split again over a finer grid, then each bucket is processed
+ * with its own octree. Indices of intersecting triangles are printed to os
+ * in ascending order, one per line.
+ */
+void findIntersections(input::TextReader& reader, std::size_t count,
+                       const Options& opts, std::ostream& os);
+
+}  // namespace ooc
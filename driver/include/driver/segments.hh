@@ -0,0 +1,36 @@
+#pragma once
+
+#include <iostream>
+
+#include "geom/intersection_segments.hh"
+
+namespace seg {
+
+/**
+ * Writes intersection segments. Text is one segment per line as indices of
+ * both triangles followed by coordinates of two endpoints. Binary is
+ * "TSEG", format version and size of coordinate as 32-bit numbers, count
+ * of segments as 64-bit one, then lanes of the buffer one after another:
+ * 64-bit indices of first and second triangles, x0, y0, z0, x1, y1 and z1.
+ * Numbers are in host byte order.
+ */
+void writeSegments(std::ostream& os,
+                   const geometry::SegmentBuffer<float>& segments,
+                   bool binary);
+void writeSegments(std::ostream& os,
+                   const geometry::SegmentBuffer<double>& segments,
+                   bool binary);
+
+/**
+ * Writes polylines. Text is one polyline per line as number of points and
+ * their coordinates. Binary is "TPLY", format version and size of
+ * coordinate as 32-bit numbers, counts of polylines and points as 64-bit
+ * ones, 64-bit offsets of polylines in points, one more than polylines,
+ * then x, y and z of every point.
+ */
+void writePolylines(std::ostream& os,
+                    const geometry::Polylines<float>& polylines, bool binary);
+void writePolylines(std::ostream& os,
+                    const geometry::Polylines<double>& polylines, bool binary);
+
+}  // namespace seg
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "geom/narrow_phase.hh"
+#include "geom/triangle3d.hh"
+
+namespace shard {
+
+/**
+ * Finds intersecting triangles with several worker processes.
+ *
+ * Scene bounding box is cut into equal slabs along its longest axis, every
+ * worker is a forked copy of this executable running in worker mode over
+ * the triangles whose ranges grown by the kernel band reach its slab. Pair
+ * is reported only by the worker whose slab contains the start of the
+ * overlap of both grown ranges on the axis, so each pair comes exactly once.
+ * Triangles and pairs travel over pipes in binary form.
+ */
+std::set<std::size_t> findIntersections(
+    const std::vector<geometry::Triangle3D<float>>& triangles,
+    unsigned workers, unsigned threads, geometry::NarrowPhase narrow_phase);
+
+/**
+ * Worker side: reads slab and its triangles from is, writes owned pairs
+ * to os.
+ */
+void runWorker(std::istream& is, std::ostream& os, unsigned threads,
+               geometry::NarrowPhase narrow_phase);
+
+}  // namespace shard
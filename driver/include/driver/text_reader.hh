@@ -0,0 +1,94 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "geom/triangle3d.hh"
+#include "geom/vector3d.hh"
+
+namespace input {
+
+/** same set as std::isspace() in the "C" locale */
+inline bool isSpace(char c) noexcept {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * Converts a whole token to a number of type V, false if it is not one.
+ */
+template <typename V>
+bool parseNumber(std::string_view token, V& value) {
+  // operator>> takes an explicit plus, from_chars does not
+  if (token.size() > 1 && token[0] == '+' && token[1] != '-') {
+    token.remove_prefix(1);
+  }
+  auto end = token.data() + token.size();
+  auto [ptr, ec] = std::from_chars(token.data(), end, value);
+  return ec == std::errc{} && ptr == end;
+}
+
+/**
+ * Reader of whitespace separated numbers. Input is taken from the stream
+ * buffer in large blocks and numbers are converted by std::from_chars, so
+ * there is no locale, sentry or stream state per number as with operator>>.
+ * The reader runs ahead of the stream, which must not be read after it.
+ */
+class TextReader final {
+ public:
+  explicit TextReader(std::istream& is, std::size_t block = kBlock);
+
+  TextReader(const TextReader&) = delete;
+  TextReader& operator=(const TextReader&) = delete;
+
+  /**
+   * Next token, valid until the next call. Empty at the end of input.
+   */
+  std::string_view next();
+
+  /** true if only whitespace is left */
+  bool atEnd();
+
+  /**
+   * Reads a number. Returns false at the end of input or if the token is
+   * not a number of type V as a whole.
+   */
+  template <typename V>
+  bool read(V& value) {
+    return parseNumber(next(), value);
+  }
+
+  template <typename T>
+  bool read(geometry::Vector3D<T>& v) {
+    return read(v.x_) && read(v.y_) && read(v.z_);
+  }
+
+  template <typename T>
+  bool read(geometry::Triangle3D<T>& t) {
+    return read(t.a_) && read(t.b_) && read(t.c_);
+  }
+
+ private:
+  static constexpr std::size_t kBlock = std::size_t{1} << 16;
+
+  /** skips whitespace, false if nothing else is left */
+  bool skipSpace();
+
+  /**
+   * Moves unread characters to the front and appends the next block.
+   * Returns false at the end of input.
+   */
+  bool refill();
+
+  std::streambuf& in_;
+  std::vector<char> buf_;
+  std::size_t block_;
+  std::size_t pos_ = 0;  // first unread character
+  std::size_t end_ = 0;  // end of read characters
+  bool eof_ = false;
+};
+
+}  // namespace input
@@ -1,11 +1,108 @@
 #include "driver/cmd_parser.hh"
 
+#include <cmath>
 #include <iostream>
+#include <string>
 
 namespace cmd {
 
+namespace {
+
+geometry::NarrowPhase parseNarrowPhase(const std::string& name) {
+  if (name == "generic") {
+    return geometry::NarrowPhase::kGeneric;
+  }
+  if (name == "interval") {
+    return geometry::NarrowPhase::kInterval;
+  }
+  if (name == "exact") {
+    return geometry::NarrowPhase::kExact;
+  }
+  throw po::invalid_option_value(name);
+}
+
+Precision parsePrecision(const std::string& name) {
+  if (name == "float") {
+    return Precision::kFloat;
+  }
+  if (name == "double") {
+    return Precision::kDouble;
+  }
+  if (name == "mixed") {
+    return Precision::kMixed;
+  }
+  throw po::invalid_option_value(name);
+}
+
+geometry::simd::Isa parseIsa(const std::string& name) {
+  if (name == "baseline") {
+    return geometry::simd::Isa::kBaseline;
+  }
+  if (name == "avx2") {
+    return geometry::simd::Isa::kAvx2;
+  }
+  if (name == "avx512") {
+    return geometry::simd::Isa::kAvx512;
+  }
+  throw po::invalid_option_value(name);
+}
+
+}  // namespace
+
 CmdParser::CmdParser(int argc, const char* const* argv) : parser_(argc, argv) {
-  desc_.add_options()("opengl", "Draw with OpenGL");
+  desc_.add_options()("opengl", "Draw with OpenGL")(
+      "sequence", "Read frames of the same triangles until EOF")(
+      "components", "Print connected groups of intersecting triangles")(
+      "input", po::value<std::string>(),
+      "Read input from file instead of standard input, plain triangles are "
+      "memory mapped and parsed on --threads threads")(
+      "threads", po::value<unsigned>()->default_value(1),
+      "Number of worker threads, 0 means all hardware threads")(
+      "time-budget", po::value<unsigned>()->default_value(0),
+      "Stop query after given milliseconds and print partial answer, 0 means "
+      "unlimited")(
+      "pipeline",
+      "Run broad and narrow phase on separate threads connected by queues of "
+      "candidate pairs, --threads sets narrow phase threads")(
+      "broad-threads", po::value<unsigned>()->default_value(1),
+      "Number of broad phase threads in --pipeline, 0 means all hardware "
+      "threads")("batch-size", po::value<std::size_t>()->default_value(1024),
+                 "Candidate pairs in one batch of --pipeline")(
+      "queue-depth", po::value<std::size_t>()->default_value(64),
+      "Batches waiting for narrow phase in --pipeline")(
+      "narrow-phase", po::value<std::string>(),
+                   "Triangle intersection kernel: generic, interval or exact")(
+      "isa", po::value<std::string>(),
+      "Instruction set of vector kernels: baseline, avx2 or avx512, the "
+      "best one of the CPU by default")(
+      "precision", po::value<std::string>(),
+      "Arithmetic of triangles: float, double or mixed")(
+      "integer",
+      "Require 32-bit integer coordinates and answer exactly without "
+      "tolerance")(
+      "mesh",
+      "Treat input as a mesh: vertices with equal coordinates are shared and "
+      "triangles touching only at shared vertices do not intersect")(
+      "indexed",
+      "Read a mesh as vertices followed by faces of three vertex indices, "
+      "implies --mesh")(
+      "snap", po::value<double>(),
+      "Collapse triangles equal after rounding coordinates to the grid of "
+      "given step, 0 collapses only exactly equal ones")(
+      "segments",
+      "Print intersection segment of every pair of intersecting triangles")(
+      "polylines", "Print intersection segments welded into polylines")(
+      "binary", "Print segments or polylines in binary format")(
+      "out-of-core",
+                   "Process input through bucket files on disk when it does "
+                   "not fit into memory")(
+      "memory-budget", po::value<std::size_t>()->default_value(1024),
+      "Memory budget for out-of-core mode in MiB")(
+      "tmp-dir", po::value<std::string>(),
+      "Directory for out-of-core bucket files")(
+      "workers", po::value<unsigned>()->default_value(1),
+      "Number of worker processes, each takes a slab of the scene")(
+      "shard-worker", "Run as worker of another process, used internally");
   parser_.options(desc_).positional(pos_desc_).allow_unregistered();
 }
 
@@ -18,6 +115,155 @@ Config CmdParser::run() {
   if (var_map_.count("opengl")) {
     cfg.draw = true;
   }
+  if (var_map_.count("sequence")) {
+    cfg.sequence = true;
+  }
+  if (var_map_.count("components")) {
+    cfg.components = true;
+  }
+  if (var_map_.count("input")) {
+    cfg.input = var_map_["input"].as<std::string>();
+  }
+  cfg.threads = var_map_["threads"].as<unsigned>();
+  cfg.time_budget_ms = var_map_["time-budget"].as<unsigned>();
+  cfg.broad_threads = var_map_["broad-threads"].as<unsigned>();
+  cfg.batch_size = var_map_["batch-size"].as<std::size_t>();
+  cfg.queue_depth = var_map_["queue-depth"].as<std::size_t>();
+  if (var_map_.count("narrow-phase")) {
+    cfg.narrow_phase =
+        parseNarrowPhase(var_map_["narrow-phase"].as<std::string>());
+  }
+  if (var_map_.count("isa")) {
+    auto name = var_map_["isa"].as<std::string>();
+    cfg.isa = parseIsa(name);
+    if (!geometry::simd::supported(cfg.isa)) {
+      throw po::error("--isa " + name + " is not supported by this CPU");
+    }
+  }
+  if (var_map_.count("out-of-core")) {
+    cfg.out_of_core = true;
+  }
+  cfg.memory_budget_mb = var_map_["memory-budget"].as<std::size_t>();
+  if (var_map_.count("tmp-dir")) {
+    cfg.tmp_dir = var_map_["tmp-dir"].as<std::string>();
+  }
+  cfg.workers = var_map_["workers"].as<unsigned>();
+  if (var_map_.count("shard-worker")) {
+    cfg.shard_worker = true;
+  }
+
+  if (var_map_.count("precision")) {
+    cfg.precision = parsePrecision(var_map_["precision"].as<std::string>());
+  }
+  // the resumable query is single-threaded and answers plain indices only
+  if (cfg.time_budget_ms != 0 &&
+      (cfg.threads != 1 || cfg.components || cfg.sequence ||
+       cfg.out_of_core || cfg.workers > 1)) {
+    throw po::error(
+        "--time-budget does not work with --threads other than 1, "
+        "--components, --sequence, --out-of-core or --workers");
+  }
+  // components are built from all pairs of a single query in one process,
+  // out-of-core query keeps none of them
+  if (cfg.components && (cfg.sequence || cfg.out_of_core || cfg.workers > 1)) {
+    throw po::error(
+        "--components does not work with --sequence, --out-of-core or "
+        "--workers");
+  }
+  // buckets answer a single scene and print nothing but indices
+  if (cfg.out_of_core && (cfg.sequence || cfg.draw || cfg.workers > 1)) {
+    throw po::error(
+        "--out-of-core does not work with --sequence, --opengl or --workers");
+  }
+  // frames are tracked by one process
+  if (cfg.sequence && cfg.workers > 1) {
+    throw po::error("--sequence does not work with --workers");
+  }
+  // 32-bit integers are exact in double, exact kernel needs no tolerance
+  if (var_map_.count("integer")) {
+    if (cfg.sequence || cfg.out_of_core || cfg.workers > 1 || cfg.draw) {
+      throw po::error(
+          "--integer does not work with --sequence, --out-of-core, --workers "
+          "or --opengl");
+    }
+    // explicit arithmetic other than the one implied is a mistake
+    if ((var_map_.count("precision") && cfg.precision != Precision::kDouble) ||
+        (var_map_.count("narrow-phase") &&
+         cfg.narrow_phase != geometry::NarrowPhase::kExact)) {
+      throw po::error(
+          "--integer does not work with --precision other than double or "
+          "--narrow-phase other than exact");
+    }
+    cfg.integer = true;
+    cfg.precision = Precision::kDouble;
+    cfg.narrow_phase = geometry::NarrowPhase::kExact;
+  }
+  // vertices are welded over the whole scene in memory
+  if (var_map_.count("mesh") || var_map_.count("indexed")) {
+    if (cfg.sequence || cfg.out_of_core || cfg.workers > 1) {
+      throw po::error(
+          "--mesh and --indexed do not work with --sequence, --out-of-core or "
+          "--workers");
+    }
+    cfg.mesh = true;
+    cfg.indexed = var_map_.count("indexed") != 0;
+  }
+  // duplicates of indexed faces are found by vertex ids, not coordinates
+  if (var_map_.count("snap")) {
+    cfg.snap = var_map_["snap"].as<double>();
+    if (!(cfg.snap >= 0) || !std::isfinite(cfg.snap)) {
+      throw po::error("--snap needs a finite step not less than 0");
+    }
+    if (cfg.sequence || cfg.out_of_core || cfg.indexed) {
+      throw po::error(
+          "--snap does not work with --sequence, --out-of-core or --indexed");
+    }
+  }
+  // segments need every pair of the whole scene in one process
+  if (var_map_.count("segments") || var_map_.count("polylines")) {
+    if (cfg.components || cfg.sequence || cfg.out_of_core ||
+        cfg.workers > 1 || cfg.draw || cfg.time_budget_ms != 0) {
+      throw po::error(
+          "--segments and --polylines do not work with --components, "
+          "--sequence, --out-of-core, --workers, --opengl or --time-budget");
+    }
+    cfg.segments = var_map_.count("segments") != 0;
+    cfg.polylines = var_map_.count("polylines") != 0;
+    if (cfg.segments && cfg.polylines) {
+      throw po::error("--segments and --polylines are mutually exclusive");
+    }
+  }
+  if (var_map_.count("binary")) {
+    if (!cfg.segments && !cfg.polylines) {
+      throw po::error("--binary needs --segments or --polylines");
+    }
+    cfg.binary = true;
+  }
+  // the pipeline replaces the traversal of a whole in-memory tree
+  if (var_map_.count("pipeline")) {
+    if (cfg.sequence || cfg.out_of_core || cfg.workers > 1 ||
+        cfg.time_budget_ms != 0) {
+      throw po::error(
+          "--pipeline does not work with --sequence, --out-of-core, "
+          "--workers or --time-budget");
+    }
+    if (cfg.batch_size == 0 || cfg.queue_depth == 0) {
+      throw po::error("--batch-size and --queue-depth must be positive");
+    }
+    cfg.pipeline = true;
+  }
+  // exact kernel needs no help, others start with float intervals
+  if (cfg.precision == Precision::kMixed &&
+      cfg.narrow_phase != geometry::NarrowPhase::kExact) {
+    cfg.narrow_phase = geometry::NarrowPhase::kMixed;
+  }
+  // workers, buckets and drawing keep triangles in float
+  if (cfg.precision == Precision::kDouble &&
+      (cfg.out_of_core || cfg.workers > 1 || cfg.shard_worker || cfg.draw)) {
+    throw po::error(
+        "double precision does not work with --out-of-core, --workers or "
+        "--opengl");
+  }
   return cfg;
 }
 
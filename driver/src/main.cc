@@ -1,8 +1,28 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
 #include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
 #include <vector>
 
 // #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
 #include "driver/cmd_parser.hh"
+#include "driver/mapped_input.hh"
+#include "driver/out_of_core.hh"
+#include "driver/segments.hh"
+#include "driver/sharding.hh"
+#include "driver/text_reader.hh"
+#include "geom/duplicates.hh"
+#include "geom/frame_tracker.hh"
+#include "geom/intersection_segments.hh"
+#include "geom/mesh.hh"
 #include "geom/octree.hh"
 #include "geom/triangle3d.hh"
 #include "glhpp/gl.hh"
@@ -10,6 +30,460 @@
 #include "triangles_gl/scene.hh"
 #include "triangles_gl/window.hh"
 
+namespace {
+
+template <typename T>
+using Triangles = std::vector<geometry::Triangle3D<T>>;
+
+// counts come from input, a wrong one must not allocate much
+constexpr std::size_t kMaxReserve = std::size_t{1} << 20;
+
+void printIndices(const std::set<std::size_t>& indices) {
+  std::copy(indices.begin(), indices.end(),
+            std::ostream_iterator<std::size_t>(std::cout, "\n"));
+}
+
+/**
+ * Prints one component per line as its size followed by its indices.
+ */
+void printComponents(
+    const std::map<std::size_t, std::vector<std::size_t>>& components) {
+  for (auto&& [root, members] : components) {
+    std::cout << members.size() << ':';
+    for (auto i : members) {
+      std::cout << ' ' << i;
+    }
+    std::cout << '\n';
+  }
+}
+
+/**
+ * Reads next frame of count triangles. Returns false if input ended before
+ * the frame.
+ */
+template <typename T>
+bool readFrame(input::TextReader& reader, Triangles<T>& frame,
+               std::size_t count) {
+  if (reader.atEnd()) {
+    return false;
+  }
+
+  frame.clear();
+  geometry::Triangle3D<T> t;
+  while (frame.size() < count && reader.read(t)) {
+    frame.push_back(t);
+  }
+  if (frame.size() != count) {
+    throw std::runtime_error("Unexpected EOF");
+  }
+  return true;
+}
+
+/**
+ * Each frame holds new positions of the same triangles, results of frames
+ * are separated with empty line.
+ */
+template <typename T>
+void runSequence(input::TextReader& reader, Triangles<T>& frame,
+                 std::size_t count, geometry::NarrowPhase narrow_phase) {
+  geometry::FrameTracker<T> tracker(frame.cbegin(), frame.cend(),
+                                    narrow_phase);
+  printIndices(tracker.getIntersections());
+
+  while (count != 0 && readFrame(reader, frame, count)) {
+    tracker.update(frame.cbegin(), frame.cend());
+    SPDLOG_DEBUG("Retested {} of {} candidate pairs", tracker.retested(),
+                 tracker.candidates());
+
+    std::cout << '\n';
+    printIndices(tracker.getIntersections());
+  }
+}
+
+/**
+ * Triangles of the query, one of every group of duplicates.
+ */
+template <typename T>
+Triangles<T> representatives(const Triangles<T>& triangles,
+                             const geometry::Duplicates& duplicates) {
+  Triangles<T> res;
+  res.reserve(duplicates.representatives().size());
+  for (auto i : duplicates.representatives()) {
+    res.push_back(triangles[i]);
+  }
+  return res;
+}
+
+template <typename T>
+geometry::IndexedMesh<T> representatives(
+    const geometry::IndexedMesh<T>& mesh,
+    const geometry::Duplicates& duplicates) {
+  geometry::IndexedMesh<T> res{mesh.vertices_, {}};
+  res.faces_.reserve(duplicates.representatives().size());
+  for (auto i : duplicates.representatives()) {
+    res.faces_.push_back(mesh.faces_[i]);
+  }
+  return res;
+}
+
+/**
+ * In mesh mode vertices with equal coordinates are welded first.
+ */
+template <typename T>
+geometry::Octree<T> makeOctree(const Triangles<T>& triangles,
+                               const cmd::Config& cfg) {
+  if (cfg.mesh) {
+    return geometry::Octree<T>(
+        geometry::weldMesh(triangles.cbegin(), triangles.cend()));
+  }
+  return {triangles.cbegin(), triangles.cend()};
+}
+
+geometry::PipelineOptions pipelineOptions(const cmd::Config& cfg) {
+  return {.broad_threads = cfg.broad_threads,
+          .narrow_threads = cfg.threads,
+          .batch_size = cfg.batch_size,
+          .queue_depth = cfg.queue_depth};
+}
+
+template <typename T>
+std::set<std::size_t> findIntersections(geometry::Octree<T>& octree,
+                                        const cmd::Config& cfg) {
+  octree.setNarrowPhase(cfg.narrow_phase);
+  if (cfg.pipeline) {
+    return octree.getIntersections(pipelineOptions(cfg));
+  }
+  if (cfg.time_budget_ms == 0) {
+    return octree.getIntersections(cfg.threads);
+  }
+
+  auto query = octree.startQuery();
+  query.run({.time = std::chrono::milliseconds(cfg.time_budget_ms)});
+  if (!query.complete()) {
+    std::cerr << "Time budget exceeded, answer covers "
+              << query.completeness() * 100 << "% of pair tests\n";
+  }
+  return query.getIntersections();
+}
+
+template <typename T>
+std::set<std::size_t> findIntersections(const Triangles<T>& triangles,
+                                        const cmd::Config& cfg) {
+  if constexpr (std::is_same_v<T, float>) {
+    if (cfg.workers > 1) {
+      return shard::findIntersections(triangles, cfg.workers, cfg.threads,
+                                      cfg.narrow_phase);
+    }
+  }
+
+  auto octree = makeOctree(triangles, cfg);
+  return findIntersections(octree, cfg);
+}
+
+template <typename T>
+std::map<std::size_t, std::vector<std::size_t>> findComponents(
+    geometry::Octree<T>& octree, const cmd::Config& cfg) {
+  octree.setNarrowPhase(cfg.narrow_phase);
+  if (cfg.pipeline) {
+    return octree.getComponents(pipelineOptions(cfg));
+  }
+  return octree.getComponents(cfg.threads);
+}
+
+/**
+ * Prints intersection segments of all intersecting pairs of the octree, or
+ * polylines welded from them. Pairs are sorted, so output does not depend
+ * on threads. Indices are of the whole input, a group of duplicates is
+ * reported by its representative.
+ */
+template <typename T>
+void printCuts(geometry::Octree<T>& octree,
+               const geometry::Duplicates& duplicates,
+               const cmd::Config& cfg) {
+  octree.setNarrowPhase(cfg.narrow_phase);
+  std::mutex mutex;
+  std::vector<std::pair<std::size_t, std::size_t>> pairs;
+  auto collect = [&mutex, &pairs](auto i, auto j) {
+    std::lock_guard lock(mutex);
+    pairs.emplace_back(std::min(i, j), std::max(i, j));
+  };
+  if (cfg.pipeline) {
+    octree.forEachIntersectingPair(collect, pipelineOptions(cfg));
+  } else {
+    octree.forEachIntersectingPair(collect, cfg.threads);
+  }
+  // a pair meets again in every node holding copies of both triangles
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+  geometry::SegmentBuffer<T> segments;
+  geometry::extractSegments(octree.preparedByIndex(), pairs, segments,
+                            cfg.threads);
+  if (!duplicates.empty()) {
+    auto&& ids = duplicates.representatives();
+    segments.renumber([&ids](auto p) { return ids[p]; });
+  }
+  if (cfg.polylines) {
+    seg::writePolylines(std::cout, geometry::weldPolylines(segments),
+                        cfg.binary);
+  } else {
+    seg::writeSegments(std::cout, segments, cfg.binary);
+  }
+}
+
+void draw(const Triangles<float>& triangles,
+          const std::set<std::size_t>& indices) {
+  constexpr auto kWindowWidth = 700u;
+  constexpr auto kWindowHeight = 700u;
+  triangles_gl::Window wnd(kWindowWidth, kWindowHeight, "Triangles3D");
+
+  glhpp::init();
+  auto shaders_path =
+      std::filesystem::absolute(__FILE__).parent_path().append("shaders");
+  std::vector<glhpp::Shader> triangles_shaders;
+  triangles_shaders.emplace_back(shaders_path / "triangles.vert",
+                                 GL_VERTEX_SHADER);
+  triangles_shaders.emplace_back(shaders_path / "triangles.frag",
+                                 GL_FRAGMENT_SHADER);
+
+  std::vector<glhpp::Shader> shadow_shaders;
+  shadow_shaders.emplace_back(shaders_path / "shadow_map.vert",
+                              GL_VERTEX_SHADER);
+  shadow_shaders.emplace_back(shaders_path / "shadow_map.frag",
+                              GL_FRAGMENT_SHADER);
+
+  glhpp::Light light{
+      .width = 2048,
+      .height = 2048,
+      .dir = {1, 1, 1},
+      .pos = {-2, -2, -2},
+      .up = {0, 1, 0},
+      .projection_matrix = glm::ortho<float>(-1.4, 1.4, -1.4, 1.4, 0.1, 5)};
+  triangles_gl::Scene scene(triangles, indices, light);
+  auto&& vertices = scene.getVertices();
+  auto vcount = vertices.size();
+  glhpp::Renderer renderer(triangles_shaders, shadow_shaders, vertices.data(),
+                           vcount * sizeof(triangles_gl::Vertex), vcount,
+                           light, kWindowWidth, kWindowHeight, GL_TRIANGLES);
+  scene.setupRenderer(renderer);
+
+  triangles_gl::Camera camera({0.f, 0.f, 0.f}, {0.f, 0.f, 1.f},
+                              {0.f, 0.1f, 0.0}, glm::radians(45.f), 0.1f,
+                              70.f);
+
+  wnd.pollInLoop(renderer, camera);
+}
+
+template <typename T>
+Triangles<T> readTriangles(input::TextReader& reader, std::size_t count) {
+  Triangles<T> triangles;
+  triangles.reserve(std::min(count, kMaxReserve));
+  geometry::Triangle3D<T> t;
+  while (reader.read(t)) {
+    triangles.push_back(t);
+  }
+  if (triangles.size() != count) {
+    throw std::runtime_error(
+        "Number of inputted triangles and initially inputted count mismatch");
+  }
+  return triangles;
+}
+
+/**
+ * Maps the input file and parses it on all threads of the query, the count
+ * is read again from the mapping.
+ */
+template <typename T>
+Triangles<T> readMapped(const cmd::Config& cfg) {
+  input::MappedFile file(cfg.input);
+  Triangles<T> triangles;
+  input::parseTriangles(file.data(), cfg.threads, triangles);
+  return triangles;
+}
+
+/**
+ * Reads a coordinate which has to be a 32-bit integer, anything else is an
+ * error. T holds it exactly.
+ */
+template <typename T>
+T readIntegralCoord(input::TextReader& reader) {
+  auto token = reader.next();
+  if (token.empty()) {
+    throw std::runtime_error("Unexpected EOF");
+  }
+  std::int32_t v;
+  auto end = token.data() + token.size();
+  auto [ptr, ec] = std::from_chars(token.data(), end, v);
+  if (ec != std::errc{} || ptr != end) {
+    throw std::runtime_error("Coordinate " + std::string(token) +
+                             " is not a 32-bit integer");
+  }
+  return v;
+}
+
+template <typename T>
+Triangles<T> readIntegral(input::TextReader& reader, std::size_t count) {
+  auto coord = [&reader] { return readIntegralCoord<T>(reader); };
+  Triangles<T> triangles;
+  triangles.reserve(std::min(count, kMaxReserve));
+  geometry::Triangle3D<T> t;
+  while (triangles.size() < count) {
+    for (auto v : {&t.a_, &t.b_, &t.c_}) {
+      *v = {coord(), coord(), coord()};  // braced list keeps the order
+    }
+    triangles.push_back(t);
+  }
+  if (!reader.atEnd()) {
+    throw std::runtime_error(
+        "Number of inputted triangles and initially inputted count mismatch");
+  }
+  return triangles;
+}
+
+/**
+ * Reads indexed mesh: count vertices, then the number of faces and three
+ * vertex indices per face.
+ */
+template <typename T>
+geometry::IndexedMesh<T> readMesh(input::TextReader& reader,
+                                  std::size_t count, bool integer) {
+  geometry::IndexedMesh<T> mesh;
+  mesh.vertices_.reserve(std::min(count, kMaxReserve));
+  geometry::Vector3D<T> v;
+  while (mesh.vertices_.size() < count) {
+    if (integer) {
+      auto coord = [&reader] { return readIntegralCoord<T>(reader); };
+      v = {coord(), coord(), coord()};
+    } else if (!reader.read(v)) {
+      throw std::runtime_error("Unexpected EOF");
+    }
+    mesh.vertices_.push_back(v);
+  }
+
+  std::size_t faces;
+  if (!reader.read(faces)) {
+    throw std::runtime_error("Unexpected EOF");
+  }
+  mesh.faces_.reserve(std::min(faces, kMaxReserve));
+  geometry::VertexIds f;
+  while (mesh.faces_.size() < faces) {
+    if (!reader.read(f[0]) || !reader.read(f[1]) || !reader.read(f[2])) {
+      throw std::runtime_error("Unexpected EOF");
+    }
+    mesh.faces_.push_back(f);
+  }
+  if (!reader.atEnd()) {
+    throw std::runtime_error(
+        "Number of inputted faces and initially inputted count mismatch");
+  }
+  if (!mesh.valid()) {
+    throw std::runtime_error("Face refers to a missing vertex");
+  }
+  return mesh;
+}
+
+/**
+ * Indexed input goes to the octree without expanding into triangles, they
+ * are built only for drawing.
+ */
+template <typename T>
+void runIndexed(input::TextReader& reader, const cmd::Config& cfg,
+                std::size_t count) {
+  auto mesh = readMesh<T>(reader, count, cfg.integer);
+  auto duplicates = geometry::findDuplicates(mesh);
+  geometry::IndexedMesh<T> unique;
+  if (!duplicates.empty()) {
+    unique = representatives(mesh, duplicates);
+  }
+  auto&& queried = duplicates.empty() ? mesh : unique;
+  geometry::Octree<T> octree(queried);
+  if (cfg.segments || cfg.polylines) {
+    printCuts(octree, duplicates, cfg);
+    return;
+  }
+  if (cfg.components) {
+    printComponents(duplicates.expand(findComponents(octree, cfg)));
+    return;
+  }
+
+  auto indices = duplicates.expand(findIntersections(octree, cfg));
+  if constexpr (std::is_same_v<T, float>) {
+    if (cfg.draw) {
+      Triangles<T> triangles;
+      triangles.reserve(mesh.size());
+      for (std::size_t i = 0; i < mesh.size(); ++i) {
+        triangles.push_back(mesh[i]);
+      }
+      draw(triangles, indices);
+      return;
+    }
+  }
+  printIndices(indices);
+}
+
+/**
+ * Reads triangles of the given precision and answers the query.
+ */
+template <typename T>
+void run(input::TextReader& reader, const cmd::Config& cfg,
+         std::size_t count) {
+  if (cfg.sequence) {
+    Triangles<T> frame;
+    if (!readFrame(reader, frame, count) && count != 0) {
+      throw std::runtime_error("Unexpected EOF");
+    }
+    runSequence(reader, frame, count, cfg.narrow_phase);
+    return;
+  }
+  if (cfg.indexed) {
+    runIndexed<T>(reader, cfg, count);
+    return;
+  }
+
+  auto triangles = cfg.integer          ? readIntegral<T>(reader, count)
+                   : !cfg.input.empty() ? readMapped<T>(cfg)
+                                        : readTriangles<T>(reader, count);
+
+  // stacked duplicates never separate in the octree, so they are queried
+  // once and answers are expanded back to all of them
+  auto duplicates =
+      geometry::findDuplicates(triangles.cbegin(), triangles.cend(), cfg.snap);
+  // snapped groups are close, not equal
+  if (cfg.snap > 0) {
+    duplicates.checkMembers([&triangles, &cfg](auto m, auto r) {
+      return geometry::intersects(triangles[m], triangles[r], cfg.narrow_phase);
+    });
+  }
+  Triangles<T> unique;
+  if (!duplicates.empty()) {
+    unique = representatives(triangles, duplicates);
+  }
+  auto&& queried = duplicates.empty() ? triangles : unique;
+
+  if (cfg.components) {
+    auto octree = makeOctree(queried, cfg);
+    printComponents(duplicates.expand(findComponents(octree, cfg)));
+    return;
+  }
+  if (cfg.segments || cfg.polylines) {
+    auto octree = makeOctree(queried, cfg);
+    printCuts(octree, duplicates, cfg);
+    return;
+  }
+
+  auto indices = duplicates.expand(findIntersections(queried, cfg));
+  // drawing takes float triangles, double ones are rejected by the parser
+  if constexpr (std::is_same_v<T, float>) {
+    if (cfg.draw) {
+      draw(triangles, indices);
+      return;
+    }
+  }
+  printIndices(indices);
+}
+
+}  // namespace
+
 int main(int argc, char** argv) try {
   cmd::CmdParser parser(argc, argv);
   auto cfg = parser.run();
@@ -17,66 +491,42 @@ int main(int argc, char** argv) try {
   // for trace and debugging
   spdlog::set_level(
       static_cast<spdlog::level::level_enum>(SPDLOG_ACTIVE_LEVEL));
+  // checked by the parser
+  geometry::simd::setIsa(cfg.isa);
+
+  if (cfg.shard_worker) {
+    shard::runWorker(std::cin, std::cout, cfg.threads, cfg.narrow_phase);
+    return 0;
+  }
 
+  std::ifstream file;
+  if (!cfg.input.empty()) {
+    file.open(cfg.input, std::ios::binary);
+    if (!file) {
+      throw std::runtime_error("Cannot open " + cfg.input);
+    }
+  }
+  input::TextReader reader(cfg.input.empty() ? std::cin : file);
   std::size_t count;
-  std::cin >> count;
-  if (!std::cin) {
+  if (!reader.read(count)) {
     throw std::runtime_error("Unexpected EOF");
   }
 
-  std::vector<geometry::Triangle3D<float>> triangles(
-      (std::istream_iterator<geometry::Triangle3D<float>>(std::cin)),
-      (std::istream_iterator<geometry::Triangle3D<float>>()));
-  if (triangles.size() != count) {
-    throw std::runtime_error(
-        "Number of inputted triangles and initially inputted count mismatch");
+  if (cfg.out_of_core) {
+    ooc::Options opts{.memory_budget = cfg.memory_budget_mb << 20,
+                      .threads = cfg.threads,
+                      .narrow_phase = cfg.narrow_phase};
+    if (!cfg.tmp_dir.empty()) {
+      opts.tmp_dir = cfg.tmp_dir;
+    }
+    ooc::findIntersections(reader, count, opts, std::cout);
+    return 0;
   }
 
-  geometry::Octree<float> octree(triangles.cbegin(), triangles.cend());
-  auto indices = octree.getIntersections();
-  if (cfg.draw) {
-    constexpr auto kWindowWidth = 700u;
-    constexpr auto kWindowHeight = 700u;
-    triangles_gl::Window wnd(kWindowWidth, kWindowHeight, "Triangles3D");
-
-    glhpp::init();
-    auto shaders_path =
-        std::filesystem::absolute(__FILE__).parent_path().append("shaders");
-    std::vector<glhpp::Shader> triangles_shaders;
-    triangles_shaders.emplace_back(shaders_path / "triangles.vert",
-                                   GL_VERTEX_SHADER);
-    triangles_shaders.emplace_back(shaders_path / "triangles.frag",
-                                   GL_FRAGMENT_SHADER);
-
-    std::vector<glhpp::Shader> shadow_shaders;
-    shadow_shaders.emplace_back(shaders_path / "shadow_map.vert",
-                                GL_VERTEX_SHADER);
-    shadow_shaders.emplace_back(shaders_path / "shadow_map.frag",
-                                GL_FRAGMENT_SHADER);
-
-    glhpp::Light light{
-        .width = 2048,
-        .height = 2048,
-        .dir = {1, 1, 1},
-        .pos = {-2, -2, -2},
-        .up = {0, 1, 0},
-        .projection_matrix = glm::ortho<float>(-1.4, 1.4, -1.4, 1.4, 0.1, 5)};
-    triangles_gl::Scene scene(triangles, indices, light);
-    auto&& vertices = scene.getVertices();
-    auto vcount = vertices.size();
-    glhpp::Renderer renderer(triangles_shaders, shadow_shaders, vertices.data(),
-                             vcount * sizeof(triangles_gl::Vertex), vcount,
-                             light, kWindowWidth, kWindowHeight, GL_TRIANGLES);
-    scene.setupRenderer(renderer);
-
-    triangles_gl::Camera camera({0.f, 0.f, 0.f}, {0.f, 0.f, 1.f},
-                                {0.f, 0.1f, 0.0}, glm::radians(45.f), 0.1f,
-                                70.f);
-
-    wnd.pollInLoop(renderer, camera);
+  if (cfg.precision == cmd::Precision::kDouble) {
+    run<double>(reader, cfg, count);
   } else {
-    std::copy(indices.begin(), indices.end(),
-              std::ostream_iterator<std::size_t>(std::cout, "\n"));
+    run<float>(reader, cfg, count);
   }
   return 0;
 } catch (std::exception& ex) {
@@ -0,0 +1,171 @@
+#include "driver/mapped_input.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "driver/text_reader.hh"
+#include "geom/parallel.hh"
+
+namespace input {
+
+namespace {
+
+// many chunks per thread balance lines of uneven length
+constexpr std::size_t kChunk = std::size_t{1} << 22;
+
+[[noreturn]] void throwErrno(const std::string& what) {
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+/**
+ * Calls f(token) for every whitespace separated token of text.
+ */
+template <typename F>
+void forEachToken(std::string_view text, F&& f) {
+  auto p = text.data(), end = p + text.size();
+  for (;;) {
+    while (p != end && isSpace(*p)) {
+      ++p;
+    }
+    if (p == end) {
+      return;
+    }
+    auto begin = p;
+    while (p != end && !isSpace(*p)) {
+      ++p;
+    }
+    f(std::string_view(begin, p - begin));
+  }
+}
+
+/**
+ * Bounds of chunks, chunk i is [bounds[i], bounds[i + 1]). Every chunk
+ * but the last ends with a line break, so no token is cut.
+ */
+std::vector<std::size_t> splitLines(std::string_view text) {
+  std::vector<std::size_t> bounds = {0};
+  while (text.size() - bounds.back() > kChunk) {
+    auto end = text.find('\n', bounds.back() + kChunk);
+    if (end == std::string_view::npos) {
+      break;
+    }
+    bounds.push_back(end + 1);
+  }
+  bounds.push_back(text.size());
+  return bounds;
+}
+
+template <typename T>
+void parse(std::string_view text, unsigned threads,
+           std::vector<geometry::Triangle3D<T>>& triangles) {
+  using Triangle = geometry::Triangle3D<T>;
+  using Vector = geometry::Vector3D<T>;
+  static constexpr Vector Triangle::*kVertex[] = {
+      &Triangle::a_, &Triangle::b_, &Triangle::c_};
+  static constexpr T Vector::*kCoord[] = {&Vector::x_, &Vector::y_,
+                                          &Vector::z_};
+
+  std::size_t count = 0;
+  auto header = std::find_if_not(text.data(), text.data() + text.size(),
+                                 isSpace);
+  auto body = std::find_if(header, text.data() + text.size(), isSpace);
+  if (!parseNumber(std::string_view(header, body - header), count)) {
+    throw std::runtime_error("Unexpected EOF");
+  }
+  text.remove_prefix(body - text.data());
+
+  auto bounds = splitLines(text);
+  auto chunks = bounds.size() - 1;
+  auto chunk = [&text, &bounds](std::size_t c) {
+    return text.substr(bounds[c], bounds[c + 1] - bounds[c]);
+  };
+
+  // offsets[c] is the index of the first coordinate of chunk c
+  std::vector<std::size_t> offsets(chunks + 1, 0);
+  geometry::parallelFor(chunks, threads, [&](std::size_t c, unsigned) {
+    std::size_t tokens = 0;
+    forEachToken(chunk(c), [&tokens](std::string_view) { ++tokens; });
+    offsets[c + 1] = tokens;
+  });
+  for (std::size_t c = 0; c < chunks; ++c) {
+    offsets[c + 1] += offsets[c];
+  }
+  // checked before the array is allocated, so a wrong count costs nothing
+  if (offsets.back() % 9 != 0 || offsets.back() / 9 != count) {
+    throw std::runtime_error(
+        "Number of inputted triangles and initially inputted count mismatch");
+  }
+
+  triangles.resize(count);
+  std::atomic<bool> malformed{false};
+  geometry::parallelFor(chunks, threads, [&](std::size_t c, unsigned) {
+    auto t = offsets[c] / 9, j = offsets[c] % 9;
+    forEachToken(chunk(c), [&](std::string_view token) {
+      if (!parseNumber(token, triangles[t].*kVertex[j / 3].*kCoord[j % 3])) {
+        malformed.store(true, std::memory_order_relaxed);
+      }
+      if (++j == 9) {
+        j = 0;
+        ++t;
+      }
+    });
+  });
+  // operator>> stops at such token and finds fewer triangles
+  if (malformed.load()) {
+    throw std::runtime_error(
+        "Number of inputted triangles and initially inputted count mismatch");
+  }
+}
+
+}  // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throwErrno(path);
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throwErrno(path);
+  }
+  size_ = st.st_size;
+  // mapping of nothing is an error, empty view does without it
+  if (size_ != 0) {
+    auto data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throwErrno(path);
+    }
+    data_ = static_cast<const char*>(data);
+    // chunks are read on many threads, all of the file is needed soon
+    ::madvise(data, size_, MADV_WILLNEED);
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+void parseTriangles(std::string_view text, unsigned threads,
+                    std::vector<geometry::Triangle3D<float>>& triangles) {
+  parse(text, threads, triangles);
+}
+
+void parseTriangles(std::string_view text, unsigned threads,
+                    std::vector<geometry::Triangle3D<double>>& triangles) {
+  parse(text, threads, triangles);
+}
+
+}  // namespace input
@@ -0,0 +1,382 @@
+#include "driver/out_of_core.hh"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "geom/octree.hh"
+#include "geom/triangle3d.hh"
+#include "spdlog/spdlog.h"
+
+namespace ooc {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using Triangle = geometry::Triangle3D<float>;
+
+struct Record final {
+  std::uint64_t index;
+  Triangle triangle;
+};
+
+/** rough in-memory cost of one triangle in bucket including octree */
+constexpr std::size_t kBytesPerTriangle = 128;
+/** limit for simultaneously open bucket files */
+constexpr std::size_t kMaxBuckets = 512;
+/** how many times oversized bucket may be split again */
+constexpr unsigned kMaxDepth = 4;
+/** buckets smaller than this are never split */
+constexpr std::size_t kMinSplitSize = 1 << 12;
+/** bounds of grid cell edge in mean triangle extents */
+constexpr double kMinCellToTriangle = 2.0;
+constexpr double kCellToTriangle = 8.0;
+
+/**
+ * Removes working directory with all bucket files on scope exit.
+ */
+class TmpDir final {
+ public:
+  explicit TmpDir(const fs::path& parent)
+      : path_(parent / ("triangles-" + std::to_string(::getpid()))) {
+    fs::create_directories(path_);
+  }
+
+  TmpDir(const TmpDir&) = delete;
+  TmpDir& operator=(const TmpDir&) = delete;
+
+  ~TmpDir() {
+    std::error_code ec;
+    fs::remove_all(path_, ec);
+  }
+
+  const fs::path& path() const noexcept { return path_; }
+
+ private:
+  fs::path path_;
+};
+
+/**
+ * Uniform grid with cells hashed to buckets.
+ */
+class Grid final {
+ public:
+  Grid(float cell, std::size_t buckets) noexcept
+      : cell_(cell), buckets_(buckets) {}
+
+  /**
+   * Calls f(bucket) once for every bucket touched by range.
+   */
+  template <typename F>
+  void forEachBucket(const geometry::Range3D<float>& r, F f) const {
+    auto lo_x = cellOf(r.min_x_), hi_x = cellOf(r.max_x_);
+    auto lo_y = cellOf(r.min_y_), hi_y = cellOf(r.max_y_);
+    auto lo_z = cellOf(r.min_z_), hi_z = cellOf(r.max_z_);
+
+    auto cells = static_cast<double>(hi_x - lo_x + 1) * (hi_y - lo_y + 1) *
+                 (hi_z - lo_z + 1);
+    if (cells >= buckets_) {
+      for (std::size_t b = 0; b < buckets_; ++b) {
+        f(b);
+      }
+      return;
+    }
+
+    touched_.clear();
+    for (auto x = lo_x; x <= hi_x; ++x) {
+      for (auto y = lo_y; y <= hi_y; ++y) {
+        for (auto z = lo_z; z <= hi_z; ++z) {
+          auto b = hash(x, y, z) % buckets_;
+          if (std::find(touched_.begin(), touched_.end(), b) ==
+              touched_.end()) {
+            touched_.push_back(b);
+            f(b);
+          }
+        }
+      }
+    }
+  }
+
+  float cell() const noexcept { return cell_; }
+  std::size_t buckets() const noexcept { return buckets_; }
+
+ private:
+  std::int64_t cellOf(float v) const noexcept {
+    return static_cast<std::int64_t>(std::floor(v / cell_));
+  }
+
+  static std::size_t hash(std::int64_t x, std::int64_t y,
+                          std::int64_t z) noexcept {
+    return static_cast<std::size_t>(x * 73856093) ^
+           static_cast<std::size_t>(y * 19349663) ^
+           static_cast<std::size_t>(z * 83492791);
+  }
+
+ private:
+  float cell_;
+  std::size_t buckets_;
+  mutable std::vector<std::size_t> touched_;
+};
+
+std::size_t bucketsFor(std::size_t triangles, std::size_t memory_budget) {
+  auto budget_triangles = std::max<std::size_t>(
+      memory_budget / kBytesPerTriangle, 1);
+  // some slack for halo and uneven hashing
+  auto buckets = 2 * (triangles + budget_triangles - 1) / budget_triangles;
+  return std::clamp<std::size_t>(buckets, 1, kMaxBuckets);
+}
+
+/**
+ * Chooses grid cell from a sample: several mean triangle extents, but small
+ * enough to give each bucket many cells for even hashing.
+ */
+float cellFor(const std::vector<Triangle>& sample, std::size_t buckets) {
+  if (sample.empty()) {
+    return 1.f;
+  }
+
+  auto bbox = sample.front().getRange();
+  double extent = 0;
+  for (auto&& t : sample) {
+    auto r = t.getRange();
+    bbox.min_x_ = std::min(bbox.min_x_, r.min_x_);
+    bbox.max_x_ = std::max(bbox.max_x_, r.max_x_);
+    bbox.min_y_ = std::min(bbox.min_y_, r.min_y_);
+    bbox.max_y_ = std::max(bbox.max_y_, r.max_y_);
+    bbox.min_z_ = std::min(bbox.min_z_, r.min_z_);
+    bbox.max_z_ = std::max(bbox.max_z_, r.max_z_);
+    extent += std::max({r.dimX(), r.dimY(), r.dimZ()});
+  }
+  extent /= sample.size();
+
+  // cells much smaller than triangles would duplicate every triangle into
+  // lots of buckets
+  auto dim = std::max({bbox.dimX(), bbox.dimY(), bbox.dimZ()});
+  auto cell = std::clamp<double>(dim / std::cbrt(16.0 * buckets),
+                                 kMinCellToTriangle * extent,
+                                 kCellToTriangle * extent);
+  return std::isfinite(cell) && cell > 0 ? static_cast<float>(cell) : 1.f;
+}
+
+/**
+ * Bucket files of one partition step, files are created on first write.
+ */
+class Buckets final {
+ public:
+  Buckets(const fs::path& dir, const std::string& prefix, const Grid& grid)
+      : dir_(dir), prefix_(prefix), grid_(grid), files_(grid.buckets()) {}
+
+  void add(const Record& rec) {
+    // pairs within the kernel band may touch, they must meet in a bucket
+    // even across a cell border
+    auto range = geometry::paddedRange(rec.triangle);
+    grid_.forEachBucket(range, [this, &rec](auto b) {
+      auto&& f = files_[b];
+      if (!f.is_open()) {
+        f.open(path(b), std::ios::binary | std::ios::trunc);
+        if (!f) {
+          throw std::runtime_error("Failed to create bucket file " +
+                                   path(b).string());
+        }
+      }
+      f.write(reinterpret_cast<const char*>(&rec), sizeof(rec));
+    });
+  }
+
+  /** flushes and closes files, returns paths of non-empty ones */
+  std::vector<fs::path> finish() {
+    std::vector<fs::path> res;
+    for (std::size_t b = 0; b < files_.size(); ++b) {
+      auto&& f = files_[b];
+      if (!f.is_open()) {
+        continue;
+      }
+      f.close();
+      if (!f) {
+        throw std::runtime_error("Failed to write bucket file " +
+                                 path(b).string());
+      }
+      res.push_back(path(b));
+    }
+    return res;
+  }
+
+ private:
+  fs::path path(std::size_t b) const {
+    return dir_ / (prefix_ + std::to_string(b) + ".bin");
+  }
+
+ private:
+  fs::path dir_;
+  std::string prefix_;
+  Grid grid_;
+  std::vector<std::ofstream> files_;
+};
+
+/**
+ * Set bits are indices of intersecting triangles, safe to fill from many
+ * threads.
+ */
+class HitSet final {
+ public:
+  HitSet() = default;
+
+  explicit HitSet(std::size_t count)
+      : words_(std::make_unique<std::atomic<std::uint64_t>[]>((count + 63) /
+                                                               64)),
+        count_(count) {}
+
+  void set(std::size_t i) noexcept {
+    words_[i / 64].fetch_or(std::uint64_t{1} << (i % 64),
+                            std::memory_order_relaxed);
+  }
+
+  void print(std::ostream& os) const {
+    for (std::size_t i = 0; i < count_; ++i) {
+      if (words_[i / 64].load(std::memory_order_relaxed) >> (i % 64) & 1) {
+        os << i << '\n';
+      }
+    }
+  }
+
+ private:
+  std::unique_ptr<std::atomic<std::uint64_t>[]> words_;
+  std::size_t count_ = 0;
+};
+
+class Pipeline final {
+ public:
+  explicit Pipeline(const Options& opts)
+      : opts_(opts), dir_(opts.tmp_dir) {}
+
+  void run(input::TextReader& reader, std::size_t count) {
+    auto buckets = bucketsFor(count, opts_.memory_budget);
+
+    // grid is chosen by the first triangles, they wait in memory for it
+    std::vector<Triangle> sample;
+    auto sample_size =
+        std::min(count, opts_.memory_budget / kBytesPerTriangle / 4 + 1);
+    Triangle t;
+    while (sample.size() < sample_size && reader.read(t)) {
+      sample.push_back(t);
+    }
+
+    Grid grid(cellFor(sample, buckets), buckets);
+    SPDLOG_DEBUG("Partitioning {} triangles into {} buckets, cell {}", count,
+                buckets, grid.cell());
+
+    Buckets files(dir_.path(), "b", grid);
+    std::uint64_t index = 0;
+    for (; index < sample.size(); ++index) {
+      files.add({index, sample[index]});
+    }
+    sample = {};
+    for (; index < count && reader.read(t); ++index) {
+      files.add({index, t});
+    }
+    if (index != count || reader.read(t)) {
+      throw std::runtime_error(
+          "Number of inputted triangles and initially inputted count mismatch");
+    }
+    // allocated only now, count comes from input and is checked above
+    hits_ = HitSet(count);
+
+    for (auto&& path : files.finish()) {
+      processBucket(path, grid.cell(), 0, 2 * count);
+    }
+    if (oversized_ != 0) {
+      std::cerr << oversized_
+                << " buckets could not be split to fit memory budget\n";
+    }
+  }
+
+  void print(std::ostream& os) const { hits_.print(os); }
+
+ private:
+  void processBucket(const fs::path& path, float cell, unsigned depth,
+                     std::size_t parent_size) {
+    auto size = fs::file_size(path) / sizeof(Record);
+    auto fits = size * kBytesPerTriangle <= opts_.memory_budget;
+    // finer grid can not separate stacked triangles, so splitting stops once
+    // it no longer shrinks buckets
+    auto shrinks = size < parent_size / 4 * 3;
+    if (!fits && shrinks && size >= kMinSplitSize && depth < kMaxDepth) {
+      splitBucket(path, size, cell / 2, depth);
+      return;
+    }
+    if (!fits) {
+      ++oversized_;
+    }
+
+    std::vector<Record> records(size);
+    {
+      std::ifstream is(path, std::ios::binary);
+      is.read(reinterpret_cast<char*>(records.data()), size * sizeof(Record));
+      if (!is) {
+        throw std::runtime_error("Failed to read bucket file " +
+                                 path.string());
+      }
+    }
+    fs::remove(path);
+
+    std::vector<Triangle> triangles(size);
+    std::transform(records.begin(), records.end(), triangles.begin(),
+                   [](const auto& r) { return r.triangle; });
+
+    geometry::Octree<float> octree(triangles.cbegin(), triangles.cend());
+    octree.setNarrowPhase(opts_.narrow_phase);
+    octree.forEachIntersectingPair(
+        [this, &records](auto i, auto j) {
+          hits_.set(records[i].index);
+          hits_.set(records[j].index);
+        },
+        opts_.threads);
+  }
+
+  void splitBucket(const fs::path& path, std::size_t size, float cell,
+                   unsigned depth) {
+    Grid grid(cell, bucketsFor(size, opts_.memory_budget));
+    SPDLOG_DEBUG("Splitting {} into {} buckets", path.string(),
+                grid.buckets());
+
+    Buckets files(dir_.path(), path.stem().string() + "_", grid);
+    {
+      std::ifstream is(path, std::ios::binary);
+      Record rec;
+      while (is.read(reinterpret_cast<char*>(&rec), sizeof(rec))) {
+        files.add(rec);
+      }
+    }
+    fs::remove(path);
+
+    for (auto&& sub : files.finish()) {
+      processBucket(sub, cell, depth + 1, size);
+    }
+  }
+
+ private:
+  const Options& opts_;
+  TmpDir dir_;
+  HitSet hits_;
+  std::size_t oversized_ = 0;
+};
+
+}  // namespace
+
+void findIntersections(input::TextReader& reader, std::size_t count,
+                       const Options& opts, std::ostream& os) {
+  Pipeline pipeline(opts);
+  pipeline.run(reader, count);
+  pipeline.print(os);
+}
+
+}  // namespace ooc
@@ -0,0 +1,104 @@
+#include "driver/segments.hh"
+
+#include <cstdint>
+#include <vector>
+
+namespace seg {
+
+namespace {
+
+constexpr std::uint32_t kVersion = 1;
+
+template <typename V>
+void put(std::ostream& os, const V& value) {
+  os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename V>
+void put(std::ostream& os, const V* values, std::size_t count) {
+  os.write(reinterpret_cast<const char*>(values), count * sizeof(V));
+}
+
+template <typename T>
+void write(std::ostream& os, const geometry::SegmentBuffer<T>& segments,
+           bool binary) {
+  using Buffer = geometry::SegmentBuffer<T>;
+  auto size = segments.size();
+  if (binary) {
+    os.write("TSEG", 4);
+    put(os, kVersion);
+    put(os, static_cast<std::uint32_t>(sizeof(T)));
+    put(os, static_cast<std::uint64_t>(size));
+    put(os, segments.first(), size);
+    put(os, segments.second(), size);
+    for (auto l = 0; l < Buffer::kLanes; ++l) {
+      put(os, segments.lane(static_cast<typename Buffer::Lane>(l)), size);
+    }
+    return;
+  }
+
+  for (std::size_t k = 0; k < size; ++k) {
+    auto s = segments[k];
+    os << segments.first()[k] << ' ' << segments.second()[k] << ' '
+       << s.begin_.x_ << ' ' << s.begin_.y_ << ' ' << s.begin_.z_ << ' '
+       << s.end_.x_ << ' ' << s.end_.y_ << ' ' << s.end_.z_ << '\n';
+  }
+}
+
+template <typename T>
+void write(std::ostream& os, const geometry::Polylines<T>& polylines,
+           bool binary) {
+  auto&& points = polylines.points_;
+  if (binary) {
+    os.write("TPLY", 4);
+    put(os, kVersion);
+    put(os, static_cast<std::uint32_t>(sizeof(T)));
+    put(os, static_cast<std::uint64_t>(polylines.size()));
+    put(os, static_cast<std::uint64_t>(points.size()));
+    std::vector<std::uint64_t> offsets(polylines.offsets_.begin(),
+                                       polylines.offsets_.end());
+    put(os, offsets.data(), offsets.size());
+    for (auto&& p : points) {
+      put(os, p.x_);
+      put(os, p.y_);
+      put(os, p.z_);
+    }
+    return;
+  }
+
+  for (std::size_t i = 0; i < polylines.size(); ++i) {
+    auto begin = polylines.offsets_[i], end = polylines.offsets_[i + 1];
+    os << end - begin << ':';
+    for (auto p = begin; p < end; ++p) {
+      os << ' ' << points[p].x_ << ' ' << points[p].y_ << ' ' << points[p].z_;
+    }
+    os << '\n';
+  }
+}
+
+}  // namespace
+
+void writeSegments(std::ostream& os,
+                   const geometry::SegmentBuffer<float>& segments,
+                   bool binary) {
+  write(os, segments, binary);
+}
+
+void writeSegments(std::ostream& os,
+                   const geometry::SegmentBuffer<double>& segments,
+                   bool binary) {
+  write(os, segments, binary);
+}
+
+void writePolylines(std::ostream& os,
+                    const geometry::Polylines<float>& polylines, bool binary) {
+  write(os, polylines, binary);
+}
+
+void writePolylines(std::ostream& os,
+                    const geometry::Polylines<double>& polylines,
+                    bool binary) {
+  write(os, polylines, binary);
+}
+
+}  // namespace seg
@@ -0,0 +1,325 @@
+#include "driver/sharding.hh"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+#include "geom/octree.hh"
+#include "spdlog/spdlog.h"
+
+namespace shard {
+
+namespace {
+
+using Triangle = geometry::Triangle3D<float>;
+
+struct SlabHeader final {
+  std::uint32_t axis;
+  float lo, hi;  // infinite at the ends of the scene
+  std::uint64_t count;
+};
+
+struct Record final {
+  std::uint64_t index;
+  Triangle triangle;
+};
+
+struct Pair final {
+  std::uint64_t i, j;
+};
+
+float axisMin(const geometry::Range3D<float>& r, unsigned axis) noexcept {
+  return axis == 0 ? r.min_x_ : axis == 1 ? r.min_y_ : r.min_z_;
+}
+
+float axisMax(const geometry::Range3D<float>& r, unsigned axis) noexcept {
+  return axis == 0 ? r.max_x_ : axis == 1 ? r.max_y_ : r.max_z_;
+}
+
+/** value of --narrow-phase for the worker */
+const char* kernelName(geometry::NarrowPhase kernel) noexcept {
+  switch (kernel) {
+    case geometry::NarrowPhase::kGeneric:
+      return "generic";
+    case geometry::NarrowPhase::kExact:
+      return "exact";
+    case geometry::NarrowPhase::kInterval:
+    case geometry::NarrowPhase::kMixed:  // with --precision mixed
+      break;
+  }
+  return "interval";
+}
+
+/** value of --isa for the worker, the one of this process */
+const char* isaName(geometry::simd::Isa isa) noexcept {
+  switch (isa) {
+    case geometry::simd::Isa::kAvx2:
+      return "avx2";
+    case geometry::simd::Isa::kAvx512:
+      return "avx512";
+    case geometry::simd::Isa::kBaseline:
+      break;
+  }
+  return "baseline";
+}
+
+[[noreturn]] void throwErrno(const std::string& what) {
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+/**
+ * Worker process connected with two pipes.
+ */
+class Worker final {
+ public:
+  Worker(unsigned threads, geometry::NarrowPhase narrow_phase) {
+    int in[2], out[2];
+    // close-on-exec keeps pipes of other workers out of this one
+    if (::pipe2(in, O_CLOEXEC) != 0) {
+      throwErrno("pipe2");
+    }
+    if (::pipe2(out, O_CLOEXEC) != 0) {
+      ::close(in[0]);
+      ::close(in[1]);
+      throwErrno("pipe2");
+    }
+
+    auto threads_str = std::to_string(threads);
+    auto kernel = kernelName(narrow_phase);
+    auto precision =
+        narrow_phase == geometry::NarrowPhase::kMixed ? "mixed" : "float";
+    auto isa = isaName(geometry::simd::activeIsa());
+    pid_ = ::fork();
+    if (pid_ == 0) {
+      ::dup2(in[0], STDIN_FILENO);
+      ::dup2(out[1], STDOUT_FILENO);
+      ::execl("/proc/self/exe", "triangles", "--shard-worker", "--threads",
+              threads_str.c_str(), "--narrow-phase", kernel, "--precision",
+              precision, "--isa", isa, nullptr);
+      ::_exit(127);
+    }
+
+    ::close(in[0]);
+    ::close(out[1]);
+    in_ = in[1];
+    out_ = out[0];
+    if (pid_ < 0) {
+      closeFds();
+      throwErrno("fork");
+    }
+  }
+
+  Worker(const Worker&) = delete;
+  Worker& operator=(const Worker&) = delete;
+
+  ~Worker() {
+    closeFds();
+    if (pid_ > 0) {
+      ::kill(pid_, SIGKILL);
+      ::waitpid(pid_, nullptr, 0);
+    }
+  }
+
+  void send(const void* data, std::size_t size) {
+    auto ptr = static_cast<const char*>(data);
+    while (size != 0) {
+      auto written = ::write(in_, ptr, size);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written < 0) {
+        throwErrno("Failed to send triangles to worker");
+      }
+      ptr += written;
+      size -= written;
+    }
+  }
+
+  void finishInput() {
+    ::close(in_);
+    in_ = -1;
+  }
+
+  /** reads pairs until worker closes its output, then reaps it */
+  std::vector<Pair> receive() {
+    std::vector<char> buf;
+    char chunk[1 << 16];
+    while (true) {
+      auto got = ::read(out_, chunk, sizeof(chunk));
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      if (got < 0) {
+        throwErrno("Failed to receive pairs from worker");
+      }
+      if (got == 0) {
+        break;
+      }
+      buf.insert(buf.end(), chunk, chunk + got);
+    }
+
+    int status = 0;
+    ::waitpid(pid_, &status, 0);
+    pid_ = -1;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+        buf.size() % sizeof(Pair) != 0) {
+      throw std::runtime_error("Worker process failed");
+    }
+
+    std::vector<Pair> res(buf.size() / sizeof(Pair));
+    std::memcpy(res.data(), buf.data(), buf.size());
+    return res;
+  }
+
+ private:
+  void closeFds() noexcept {
+    for (auto fd : {in_, out_}) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+    }
+    in_ = out_ = -1;
+  }
+
+ private:
+  pid_t pid_ = -1;
+  int in_ = -1;
+  int out_ = -1;
+};
+
+}  // namespace
+
+std::set<std::size_t> findIntersections(const std::vector<Triangle>& triangles,
+                                        unsigned workers, unsigned threads,
+                                        geometry::NarrowPhase narrow_phase) {
+  if (triangles.empty()) {
+    return {};
+  }
+
+  auto bbox = triangles.front().getRange();
+  for (auto&& t : triangles) {
+    auto r = t.getRange();
+    bbox.min_x_ = std::min(bbox.min_x_, r.min_x_);
+    bbox.max_x_ = std::max(bbox.max_x_, r.max_x_);
+    bbox.min_y_ = std::min(bbox.min_y_, r.min_y_);
+    bbox.max_y_ = std::max(bbox.max_y_, r.max_y_);
+    bbox.min_z_ = std::min(bbox.min_z_, r.min_z_);
+    bbox.max_z_ = std::max(bbox.max_z_, r.max_z_);
+  }
+  auto dims = {bbox.dimX(), bbox.dimY(), bbox.dimZ()};
+  auto axis = static_cast<unsigned>(std::max_element(dims.begin(), dims.end()) -
+                                    dims.begin());
+  auto lo = axisMin(bbox, axis);
+  auto hi = axisMax(bbox, axis);
+
+  ::signal(SIGPIPE, SIG_IGN);
+  std::vector<std::unique_ptr<Worker>> pool;
+  for (unsigned w = 0; w < workers; ++w) {
+    pool.push_back(std::make_unique<Worker>(threads, narrow_phase));
+  }
+
+  // padded ranges of pairs within the kernel band overlap, a slab takes
+  // every triangle whose padded range reaches it
+  std::vector<geometry::Range3D<float>> padded(triangles.size());
+  for (std::size_t i = 0; i < triangles.size(); ++i) {
+    padded[i] = geometry::paddedRange(triangles[i]);
+  }
+
+  constexpr auto kInf = std::numeric_limits<float>::infinity();
+  for (unsigned w = 0; w < workers; ++w) {
+    auto slab_lo = w == 0 ? -kInf : lo + (hi - lo) * w / workers;
+    auto slab_hi =
+        w + 1 == workers ? kInf : lo + (hi - lo) * (w + 1) / workers;
+
+    std::vector<Record> records;
+    for (std::size_t i = 0; i < triangles.size(); ++i) {
+      if (axisMax(padded[i], axis) >= slab_lo &&
+          axisMin(padded[i], axis) <= slab_hi) {
+        records.push_back({i, triangles[i]});
+      }
+    }
+
+    SlabHeader header{axis, slab_lo, slab_hi, records.size()};
+    pool[w]->send(&header, sizeof(header));
+    pool[w]->send(records.data(), records.size() * sizeof(Record));
+    pool[w]->finishInput();
+  }
+
+  std::set<std::size_t> res;
+  std::size_t pairs = 0;
+  for (auto&& worker : pool) {
+    for (auto&& p : worker->receive()) {
+      res.insert(p.i);
+      res.insert(p.j);
+      ++pairs;
+    }
+  }
+  SPDLOG_DEBUG("{} workers found {} pairs", workers, pairs);
+  return res;
+}
+
+void runWorker(std::istream& is, std::ostream& os, unsigned threads,
+               geometry::NarrowPhase narrow_phase) {
+  SlabHeader header;
+  if (!is.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    throw std::runtime_error("Unexpected EOF");
+  }
+
+  std::vector<Record> records(header.count);
+  if (!is.read(reinterpret_cast<char*>(records.data()),
+               records.size() * sizeof(Record))) {
+    throw std::runtime_error("Unexpected EOF");
+  }
+
+  std::vector<Triangle> triangles(records.size());
+  std::vector<geometry::Range3D<float>> ranges(records.size());
+  for (std::size_t i = 0; i < records.size(); ++i) {
+    triangles[i] = records[i].triangle;
+    ranges[i] = geometry::paddedRange(triangles[i]);
+  }
+
+  std::mutex mutex;
+  std::vector<Pair> owned;
+  geometry::Octree<float> octree(triangles.cbegin(), triangles.cend());
+  octree.setNarrowPhase(narrow_phase);
+  octree.forEachIntersectingPair(
+      [&](auto i, auto j) {
+        auto start = std::max(axisMin(ranges[i], header.axis),
+                              axisMin(ranges[j], header.axis));
+        if (start < header.lo || start >= header.hi) {
+          return;  // belongs to neighbour slab
+        }
+        auto [a, b] = std::minmax(records[i].index, records[j].index);
+        std::lock_guard lock(mutex);
+        owned.push_back({a, b});
+      },
+      threads);
+  // the octree meets a pair again in every node holding copies of both
+  auto less = [](const Pair& l, const Pair& r) {
+    return std::tie(l.i, l.j) < std::tie(r.i, r.j);
+  };
+  auto equal = [](const Pair& l, const Pair& r) {
+    return l.i == r.i && l.j == r.j;
+  };
+  std::sort(owned.begin(), owned.end(), less);
+  owned.erase(std::unique(owned.begin(), owned.end(), equal), owned.end());
+
+  os.write(reinterpret_cast<const char*>(owned.data()),
+           owned.size() * sizeof(Pair));
+  os.flush();
+}
+
+}  // namespace shard
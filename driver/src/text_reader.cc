@@ -0,0 +1,71 @@
+#include "driver/text_reader.hh"
+
+#include <algorithm>
+
+namespace input {
+
+TextReader::TextReader(std::istream& is, std::size_t block)
+    : in_(*is.rdbuf()), buf_(block), block_(block) {}
+
+std::string_view TextReader::next() {
+  if (!skipSpace()) {
+    return {};
+  }
+  auto end = pos_;
+  for (;;) {
+    while (end < end_ && !isSpace(buf_[end])) {
+      ++end;
+    }
+    if (end < end_) {
+      break;
+    }
+    // token goes on in the next block, refill() moves it to the front
+    auto length = end - pos_;
+    auto more = refill();
+    end = pos_ + length;
+    if (!more) {
+      break;
+    }
+  }
+  std::string_view res(buf_.data() + pos_, end - pos_);
+  pos_ = end;
+  return res;
+}
+
+bool TextReader::atEnd() { return !skipSpace(); }
+
+bool TextReader::skipSpace() {
+  for (;;) {
+    while (pos_ < end_ && isSpace(buf_[pos_])) {
+      ++pos_;
+    }
+    if (pos_ < end_) {
+      return true;
+    }
+    if (!refill()) {
+      return false;
+    }
+  }
+}
+
+bool TextReader::refill() {
+  if (eof_) {
+    return false;
+  }
+  std::copy(buf_.begin() + pos_, buf_.begin() + end_, buf_.begin());
+  end_ -= pos_;
+  pos_ = 0;
+  // a token longer than the buffer grows it
+  if (buf_.size() - end_ < block_) {
+    buf_.resize(end_ + block_);
+  }
+  auto read = in_.sgetn(buf_.data() + end_, block_);
+  if (read <= 0) {
+    eof_ = true;
+    return false;
+  }
+  end_ += read;
+  return true;
+}
+
+}  // namespace input
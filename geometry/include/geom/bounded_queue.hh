@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace geometry {
+
+/**
+ * Lock-free bounded queue for many producers and many consumers.
+ *
+ * Every cell carries a sequence number which tells the lap it waits for:
+ * equal to the position it is free for a push, one more it holds a value
+ * for a pop. Threads race only for positions with CAS on head or tail, the
+ * winner then owns the cell until it bumps the sequence. Capacity is
+ * rounded up to a power of two.
+ */
+template <typename V>
+class BoundedQueue final {
+ public:
+  explicit BoundedQueue(std::size_t capacity) {
+    std::size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+    cells_ = std::make_unique<Cell[]>(size);
+    mask_ = size - 1;
+    for (std::size_t i = 0; i < size; ++i) {
+      cells_[i].sequence_.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  std::size_t capacity() const noexcept { return mask_ + 1; }
+
+  /** false if the queue is full */
+  bool tryPush(V value) noexcept {
+    auto pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto&& cell = cells_[pos & mask_];
+      auto seq = cell.sequence_.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(seq) -
+                  static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          cell.value_ = std::move(value);
+          cell.sequence_.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /** false if the queue is empty */
+  bool tryPop(V& value) noexcept {
+    auto pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      auto&& cell = cells_[pos & mask_];
+      auto seq = cell.sequence_.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(seq) -
+                  static_cast<std::intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          value = std::move(cell.value_);
+          // free for the push of the next lap
+          cell.sequence_.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+ private:
+  struct Cell final {
+    std::atomic<std::size_t> sequence_;
+    V value_;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  std::size_t mask_ = 0;
+  // apart from each other, so producers and consumers do not share a line
+  alignas(64) std::atomic<std::size_t> tail_{0};  // next push
+  alignas(64) std::atomic<std::size_t> head_{0};  // next pop
+};
+
+}  // namespace geometry
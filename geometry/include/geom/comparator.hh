@@ -38,4 +38,15 @@ inline bool isGreaterClose(const T& a, const T& b,
   return isClose(a, b, abs_tol, rel_tol) || a > b;
 }
 
+/**
+ * Distance within which kernels take points with coordinates up to scale
+ * for contact: the tolerance with a margin for rounding of all kernels.
+ * Ranges grown by it on both sides of a pair overlap for every pair which
+ * may be reported as touching.
+ */
+template <typename T>
+inline T kernelBand(const T& scale) noexcept {
+  return 16 * std::max(kAbsTol<T>, kRelTol<T> * scale);
+}
+
 }  // namespace comparator
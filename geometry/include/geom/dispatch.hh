@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "comparator.hh"
+#include "simd.hh"
+
+namespace geometry {
+
+namespace simd {
+
+/**
+ * Instruction sets with their own kernels. Baseline is the target of the
+ * translation unit, the others are used only on CPUs which have them.
+ */
+enum class Isa {
+  kBaseline,
+  kAvx2,
+  kAvx512,  // F and BW
+};
+
+/** lanes of one kernel call, bits of one mask */
+inline constexpr unsigned kBlock = 32;
+
+/** coordinate lanes of TriangleBatch: x, y, z of a, b and c */
+enum TriangleLane {
+  kAx, kAy, kAz,
+  kBx, kBy, kBz,
+  kCx, kCy, kCz,
+  kTriangleLanes
+};
+
+/**
+ * Single triangle tested against a batch: vertices, raw normal with its
+ * squared norm and error, scale of coordinates.
+ */
+template <typename T>
+struct TriangleQuery final {
+  T v_[kTriangleLanes];
+  T n_[3];
+  T n2_, err_, scale_;
+};
+
+namespace base {
+template <typename T>
+using Wide = Native<T>;
+#include "simd_kernels.hh"
+}  // namespace base
+
+#if defined(GEOMETRY_SIMD_DISPATCH)
+GEOMETRY_TARGET_BEGIN("avx2")
+namespace avx2 {
+template <typename T>
+using Wide = std::conditional_t<std::is_same_v<T, float>, Avx2Float,
+                                Avx2Double>;
+#include "simd_kernels.hh"
+}  // namespace avx2
+GEOMETRY_TARGET_END()
+
+GEOMETRY_TARGET_BEGIN("avx512f,avx512bw")
+namespace avx512 {
+template <typename T>
+using Wide = std::conditional_t<std::is_same_v<T, float>, Avx512Float,
+                                Avx512Double>;
+#include "simd_kernels.hh"
+}  // namespace avx512
+GEOMETRY_TARGET_END()
+#endif
+
+/**
+ * Whether the running CPU and OS support isa.
+ */
+inline bool supported(Isa isa) noexcept {
+#if defined(GEOMETRY_SIMD_DISPATCH)
+  // may run before constructors of libgcc, from static initialization
+  __builtin_cpu_init();
+  switch (isa) {
+    case Isa::kBaseline:
+      return true;
+    case Isa::kAvx2:
+      return __builtin_cpu_supports("avx2");
+    case Isa::kAvx512:
+      return __builtin_cpu_supports("avx512f") &&
+             __builtin_cpu_supports("avx512bw");
+  }
+  return false;
+#else
+  return isa == Isa::kBaseline;
+#endif
+}
+
+/** widest instruction set of the running CPU */
+inline Isa bestIsa() noexcept {
+  for (auto isa : {Isa::kAvx512, Isa::kAvx2}) {
+    if (supported(isa)) {
+      return isa;
+    }
+  }
+  return Isa::kBaseline;
+}
+
+/**
+ * Entry points of one instruction set.
+ */
+struct Kernels final {
+  std::uint32_t (*overlapping_boxes)(const std::uint16_t*, std::size_t,
+                                     std::size_t, const std::uint16_t*,
+                                     const std::uint16_t*) noexcept;
+  std::uint32_t (*candidates_float)(const TriangleQuery<float>&,
+                                    const float*, std::size_t, std::size_t,
+                                    std::uint32_t) noexcept;
+  std::uint32_t (*candidates_double)(const TriangleQuery<double>&,
+                                     const double*, std::size_t,
+                                     std::size_t, std::uint32_t) noexcept;
+
+  template <typename T>
+  auto candidates() const noexcept {
+    if constexpr (std::is_same_v<T, float>) {
+      return candidates_float;
+    } else {
+      return candidates_double;
+    }
+  }
+};
+
+/**
+ * Table of isa, which has to be supported.
+ */
+inline const Kernels& kernels(Isa isa) noexcept {
+  static constexpr Kernels kTable[] = {
+      {&base::overlappingBoxes, &base::batchCandidatesBlock<float>,
+       &base::batchCandidatesBlock<double>},
+#if defined(GEOMETRY_SIMD_DISPATCH)
+      {&avx2::overlappingBoxes, &avx2::batchCandidatesBlock<float>,
+       &avx2::batchCandidatesBlock<double>},
+      {&avx512::overlappingBoxes, &avx512::batchCandidatesBlock<float>,
+       &avx512::batchCandidatesBlock<double>},
+#endif
+  };
+  return kTable[static_cast<int>(isa)];
+}
+
+namespace detail {
+inline std::atomic<Isa> active_isa{bestIsa()};
+}  // namespace detail
+
+/** instruction set of kernels, the best one of the CPU unless changed */
+inline Isa activeIsa() noexcept {
+  return detail::active_isa.load(std::memory_order_relaxed);
+}
+
+/**
+ * Switches kernels to isa, meant for startup and benchmarks. Returns false
+ * and changes nothing if the CPU does not support it.
+ */
+inline bool setIsa(Isa isa) noexcept {
+  if (!supported(isa)) {
+    return false;
+  }
+  detail::active_isa.store(isa, std::memory_order_relaxed);
+  return true;
+}
+
+inline const Kernels& activeKernels() noexcept {
+  return kernels(activeIsa());
+}
+
+}  // namespace simd
+
+}  // namespace geometry
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mesh.hh"
+#include "triangle3d.hh"
+
+namespace geometry {
+
+/**
+ * Groups of equal triangles of a scene. Each group is represented by its
+ * first triangle, queries run over representatives only and their answers
+ * are expanded back to every member. Equal triangles intersect each other,
+ * so members of groups with more than one triangle are always in the
+ * answer. Groups of merely close triangles need checkMembers() first.
+ */
+class Duplicates final {
+ public:
+  Duplicates() = default;
+
+  /**
+   * key(i) gives the canonical key of i-th element, equal keys make one
+   * group and nullopt keeps the element alone.
+   */
+  template <typename Key>
+  Duplicates(std::size_t count, Key key) {
+    assert(count <= UINT32_MAX);
+    // equal keys are found by hashes first, sort keeps equal hashes in the
+    // order of elements, so first equal key is the representative
+    std::vector<std::pair<std::size_t, std::uint32_t>> hashes;
+    hashes.reserve(count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      if (auto k = key(i)) {
+        hashes.emplace_back(hash(*k), i);
+      }
+    }
+    std::sort(hashes.begin(), hashes.end());
+
+    std::vector<std::uint32_t> first(count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      first[i] = i;
+    }
+    for (auto run = hashes.begin(); run != hashes.end();) {
+      auto run_end = std::find_if(run, hashes.end(), [run](auto&& h) {
+        return h.first != run->first;
+      });
+      // different keys with one hash are rare, each gets its own pass
+      for (auto i = run; i != run_end; ++i) {
+        if (first[i->second] != i->second || std::next(i) == run_end) {
+          continue;
+        }
+        auto k = key(i->second);
+        for (auto j = std::next(i); j != run_end; ++j) {
+          if (first[j->second] == j->second && key(j->second) == k) {
+            first[j->second] = i->second;
+          }
+        }
+      }
+      run = run_end;
+    }
+
+    count_ = count;
+    std::vector<std::uint32_t> positions(count);  // group of every element
+    representatives_.reserve(count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      if (first[i] == i) {
+        positions[i] = representatives_.size();
+        representatives_.push_back(i);
+      } else {
+        positions[i] = positions[first[i]];
+      }
+    }
+    // answers need no expansion then
+    if (empty()) {
+      return;
+    }
+
+    offsets_.assign(representatives_.size() + 1, 0);
+    for (auto p : positions) {
+      ++offsets_[p + 1];
+    }
+    std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+    members_.resize(count);
+    auto next = offsets_;
+    for (std::uint32_t i = 0; i < count; ++i) {
+      members_[next[positions[i]]++] = i;
+    }
+  }
+
+  /** no element has an equal one */
+  bool empty() const noexcept { return representatives_.size() == count_; }
+
+  /**
+   * Members for which touches(member, representative) is false are in the
+   * answer only with their representative. Groups made by snapping need it,
+   * their members may be apart.
+   */
+  template <typename Touches>
+  void checkMembers(Touches touches) {
+    if (empty()) {
+      return;
+    }
+    apart_.assign(count_, false);
+    for (std::size_t p = 0; p < representatives_.size(); ++p) {
+      auto first = members_.begin() + offsets_[p];
+      for (auto m = first + 1; m != members_.begin() + offsets_[p + 1];
+           ++m) {
+        apart_[*m] = !touches(std::size_t{*m}, std::size_t{*first});
+      }
+    }
+  }
+
+  /** first element of every group, ascending */
+  const std::vector<std::size_t>& representatives() const noexcept {
+    return representatives_;
+  }
+
+  /**
+   * Takes answer of a query over representatives, where indices are
+   * positions in representatives(), and gives the answer for all elements.
+   */
+  std::set<std::size_t> expand(const std::set<std::size_t>& hits) const {
+    if (empty()) {
+      return hits;
+    }
+    std::vector<std::size_t> res;
+    for (std::size_t p = 0; p < representatives_.size(); ++p) {
+      if (hits.count(p)) {
+        res.insert(res.end(), members_.begin() + offsets_[p],
+                   members_.begin() + offsets_[p + 1]);
+      } else {
+        addTouching(res, p);
+      }
+    }
+    return {res.begin(), res.end()};
+  }
+
+  /**
+   * Same for connected components keyed by their smallest index. Groups
+   * which intersect nothing else are components of their own, of members
+   * touching the representative.
+   */
+  std::map<std::size_t, std::vector<std::size_t>> expand(
+      const std::map<std::size_t, std::vector<std::size_t>>& components)
+      const {
+    if (empty()) {
+      return components;
+    }
+    std::map<std::size_t, std::vector<std::size_t>> res;
+    std::vector<bool> covered(representatives_.size());
+    auto add = [this](std::vector<std::size_t>& to, std::size_t p) {
+      to.insert(to.end(), members_.begin() + offsets_[p],
+                members_.begin() + offsets_[p + 1]);
+    };
+    for (auto&& [root, positions] : components) {
+      std::vector<std::size_t> members;
+      for (auto p : positions) {
+        covered[p] = true;
+        add(members, p);
+      }
+      std::sort(members.begin(), members.end());
+      res.emplace(members.front(), std::move(members));
+    }
+    for (std::size_t p = 0; p < representatives_.size(); ++p) {
+      std::vector<std::size_t> members;
+      if (!covered[p] && addTouching(members, p)) {
+        res.emplace(members.front(), std::move(members));
+      }
+    }
+    return res;
+  }
+
+ private:
+  /**
+   * Appends members of group p touching its representative and the
+   * representative itself if there are any, false if there are none.
+   */
+  bool addTouching(std::vector<std::size_t>& to, std::size_t p) const {
+    auto first = members_.begin() + offsets_[p];
+    auto last = members_.begin() + offsets_[p + 1];
+    to.push_back(*first);
+    auto size = to.size();
+    std::copy_if(first + 1, last, std::back_inserter(to),
+                 [this](auto m) { return apart_.empty() || !apart_[m]; });
+    if (to.size() == size) {
+      to.pop_back();
+      return false;
+    }
+    return true;
+  }
+
+  template <typename Key>
+  static std::size_t hash(const Key& key) noexcept {
+    std::size_t res = 0;
+    for (auto&& v : key) {
+      using V = std::remove_cv_t<std::remove_reference_t<decltype(v)>>;
+      res = (res ^ std::hash<V>{}(v)) * 0x100000001b3;
+    }
+    return res;
+  }
+
+ private:
+  std::size_t count_ = 0;
+  std::vector<std::size_t> representatives_;
+  std::vector<std::uint32_t> offsets_;    // of groups in members_
+  std::vector<std::uint32_t> members_;    // elements sorted by groups
+  std::vector<bool> apart_;  // member apart from its representative
+};
+
+/**
+ * Groups triangles of a random access range with equal vertices, in any
+ * order. With nonzero snap coordinates are rounded to the grid of that step
+ * first, so triangles which differ by less than a step usually fall into
+ * one group as well. Triangles with NaN or infinite coordinates are never
+ * grouped.
+ */
+template <typename It>
+Duplicates findDuplicates(It begin, It end, double snap = 0) {
+  using Triangle = typename std::iterator_traits<It>::value_type;
+  using T = std::remove_cv_t<decltype(Triangle::a_.x_)>;
+  auto coord = [snap](T x) -> T {
+    // sum with zero turns -0 into 0, they are one value in keys
+    return (snap > 0 ? std::round(x / snap) * snap : x) + 0;
+  };
+  auto key = [begin, &coord](std::size_t i)
+      -> std::optional<std::array<T, 9>> {
+    auto&& t = begin[i];
+    std::array<Vector3D<T>, 3> v = {t.a_, t.b_, t.c_};
+    std::array<T, 9> res;
+    for (auto k = 0; k < 3; ++k) {
+      if (!v[k].valid()) {
+        return std::nullopt;
+      }
+      res[3 * k] = coord(v[k].x_);
+      res[3 * k + 1] = coord(v[k].y_);
+      res[3 * k + 2] = coord(v[k].z_);
+    }
+    auto vertex = [&res](auto k) {
+      return std::tie(res[3 * k], res[3 * k + 1], res[3 * k + 2]);
+    };
+    // three elements are sorted by three compare-and-swap steps
+    auto order = [&res, &vertex](auto l, auto r) {
+      if (vertex(r) < vertex(l)) {
+        std::swap_ranges(res.begin() + 3 * l, res.begin() + 3 * l + 3,
+                         res.begin() + 3 * r);
+      }
+    };
+    order(0, 1);
+    order(1, 2);
+    order(0, 1);
+    return res;
+  };
+  return Duplicates(std::distance(begin, end), key);
+}
+
+/**
+ * Groups faces with equal vertex ids, in any order. Faces with NaN or
+ * infinite coordinates are never grouped.
+ */
+template <typename T>
+Duplicates findDuplicates(const IndexedMesh<T>& mesh) {
+  return Duplicates(
+      mesh.size(), [&mesh](std::size_t i) -> std::optional<VertexIds> {
+        auto res = mesh.faces_[i];
+        for (auto v : res) {
+          if (!mesh.vertices_[v].valid()) {
+            return std::nullopt;
+          }
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+      });
+}
+
+}  // namespace geometry
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <utility>
+
+#include "predicates.hh"
+#include "triangle3d.hh"
+
+namespace geometry {
+
+namespace detail {
+
+/**
+ * Guigue and Devillers' triangle-triangle overlap test with every decision
+ * taken by exact orientation predicates, degenerate triangles are reduced
+ * to segments and points and tested exactly too. Triangles are closed, so
+ * touching ones intersect. T is float, double or std::int32_t.
+ */
+template <typename T>
+class ExactIntersection final {
+  using Point = Vector3D<T>;
+  using Point2D = predicates::Point2D<T>;
+
+  /** endpoints of a degenerate triangle, equal for a point */
+  struct Segment final {
+    const Point* p_;
+    const Point* q_;
+
+    bool point() const noexcept { return same(*p_, *q_); }
+  };
+
+ public:
+  static bool collinear(const Triangle3D<T>& t) noexcept {
+    return predicates::collinear(t.a_, t.b_, t.c_);
+  }
+
+  /**
+   * Whether proper triangles abc and ade with common vertex a meet anywhere
+   * else. Crossing planes meet in a line through a, and each triangle cuts
+   * a segment from a to its opposite edge out of it: the segments overlap
+   * iff one of opposite edges touches the other triangle. Coplanar ones
+   * overlap iff their angles at a share a ray.
+   */
+  static bool beyondVertex(const Triangle3D<T>& t1,
+                           const Triangle3D<T>& t2) noexcept {
+    auto&& a = t1.a_;
+    if (predicates::orient3d(a, t1.b_, t1.c_, t2.b_) != 0 ||
+        predicates::orient3d(a, t1.b_, t1.c_, t2.c_) != 0) {
+      return test({t1.b_, t1.c_, t1.c_}, t2) ||
+             test({t2.b_, t2.c_, t2.c_}, t1);
+    }
+
+    auto axis = projectionAxis(t1);
+    auto pa = project(a, axis);
+    auto pb = project(t1.b_, axis), pc = project(t1.c_, axis);
+    auto pd = project(t2.b_, axis), pe = project(t2.c_, axis);
+    // closed angle between rays au and av, less than a half-turn
+    auto inAngle = [&pa](const Point2D& u, const Point2D& v,
+                         const Point2D& r) {
+      auto o = orient(pa, u, v);
+      return orient(pa, u, r) * o >= 0 && orient(pa, r, v) * o >= 0;
+    };
+    return inAngle(pb, pc, pd) || inAngle(pb, pc, pe) ||
+           inAngle(pd, pe, pb) || inAngle(pd, pe, pc);
+  }
+
+  /**
+   * Whether proper triangles abc and abd with common edge ab meet anywhere
+   * else. Crossing planes meet in the line of ab only, coplanar triangles
+   * overlap iff c and d lie on one side of ab.
+   */
+  static bool beyondEdge(const Triangle3D<T>& t1,
+                         const Triangle3D<T>& t2) noexcept {
+    if (predicates::orient3d(t1.a_, t1.b_, t1.c_, t2.c_) != 0) {
+      return false;
+    }
+    auto axis = projectionAxis(t1);
+    auto pa = project(t1.a_, axis), pb = project(t1.b_, axis);
+    return orient(pa, pb, project(t1.c_, axis)) ==
+           orient(pa, pb, project(t2.c_, axis));
+  }
+
+  static bool test(const Triangle3D<T>& t1, const Triangle3D<T>& t2) noexcept {
+    const Point* v1[3] = {&t1.a_, &t1.b_, &t1.c_};
+    const Point* v2[3] = {&t2.a_, &t2.b_, &t2.c_};
+
+    // sides of vertices of each triangle relative to the plane of the other
+    int s1[3], s2[3];
+    for (auto i = 0; i < 3; ++i) {
+      s1[i] = predicates::orient3d(t2.a_, t2.b_, t2.c_, *v1[i]);
+    }
+    if (oneSide(s1)) {
+      return false;
+    }
+    for (auto i = 0; i < 3; ++i) {
+      s2[i] = predicates::orient3d(t1.a_, t1.b_, t1.c_, *v2[i]);
+    }
+    if (oneSide(s2)) {
+      return false;
+    }
+
+    // vertices of one triangle all on the plane of the other one, also the
+    // case for every degenerate triangle
+    if ((s1[0] == 0 && s1[1] == 0 && s1[2] == 0) ||
+        (s2[0] == 0 && s2[1] == 0 && s2[2] == 0)) {
+      auto d1 = collinear(t1), d2 = collinear(t2);
+      if (d1 && d2) {
+        return segments(extremes(t1), extremes(t2));
+      }
+      if (d1 || d2) {
+        return d1 ? segmentTriangle(extremes(t1), t2)
+                  : segmentTriangle(extremes(t2), t1);
+      }
+      return coplanar(t1, t2);
+    }
+
+    // Rotate both triangles so that p is the vertex alone on its side of
+    // the other plane, then flip them so that this side is negative:
+    // swapping q and r of one triangle negates signs of the other one.
+    auto [i1, side1] = alone(s1);
+    auto [i2, side2] = alone(s2);
+    auto p1 = v1[i1], q1 = v1[(i1 + 1) % 3], r1 = v1[(i1 + 2) % 3];
+    auto p2 = v2[i2], q2 = v2[(i2 + 1) % 3], r2 = v2[(i2 + 2) % 3];
+    if (side1 > 0) {
+      std::swap(q2, r2);
+    }
+    if (side2 > 0) {
+      std::swap(q1, r1);
+    }
+
+    // both triangles cut a segment from the line where the planes meet,
+    // two orientations tell whether these segments overlap
+    return predicates::orient3d(*p1, *q1, *p2, *q2) >= 0 &&
+           predicates::orient3d(*p1, *r1, *r2, *p2) >= 0;
+  }
+
+ private:
+  static bool oneSide(const int s[3]) noexcept {
+    return s[0] * s[1] > 0 && s[0] * s[2] > 0;
+  }
+
+  /**
+   * Vertex whose side differs from both other ones and that side, a vertex
+   * on the plane takes the side opposite to the other two.
+   */
+  static std::pair<int, int> alone(const int s[3]) noexcept {
+    for (auto i = 0; i < 3; ++i) {
+      auto j = (i + 1) % 3, k = (i + 2) % 3;
+      if (s[i] != 0 && s[i] * s[j] <= 0 && s[i] * s[k] <= 0) {
+        return {i, s[i]};
+      }
+    }
+    // two vertices strictly on one side, the third one on the plane
+    auto i = s[0] == 0 ? 0 : s[1] == 0 ? 1 : 2;
+    return {i, -s[(i + 1) % 3]};
+  }
+
+  static bool same(const Point& a, const Point& b) noexcept {
+    return a.x_ == b.x_ && a.y_ == b.y_ && a.z_ == b.z_;
+  }
+
+  /** points of one line are ordered along it lexicographically */
+  static bool less(const Point& a, const Point& b) noexcept {
+    return std::tie(a.x_, a.y_, a.z_) < std::tie(b.x_, b.y_, b.z_);
+  }
+
+  static Segment extremes(const Triangle3D<T>& t) noexcept {
+    const Point* v[3] = {&t.a_, &t.b_, &t.c_};
+    auto [lo, hi] = std::minmax_element(
+        v, v + 3, [](auto l, auto r) { return less(*l, *r); });
+    return {*lo, *hi};
+  }
+
+  static bool onSegment(const Segment& s, const Point& x) noexcept {
+    return predicates::collinear(*s.p_, *s.q_, x) && !less(x, *s.p_) &&
+           !less(*s.q_, x);
+  }
+
+  static bool segments(const Segment& s1, const Segment& s2) noexcept {
+    if (s1.point()) {
+      return onSegment(s2, *s1.p_);
+    }
+    if (s2.point()) {
+      return onSegment(s1, *s2.p_);
+    }
+    auto&& p = *s1.p_, &q = *s1.q_, &r = *s2.p_, &s = *s2.q_;
+    if (predicates::orient3d(p, q, r, s) != 0) {
+      return false;
+    }
+    if (predicates::collinear(p, q, r) && predicates::collinear(p, q, s)) {
+      return !less(q, r) && !less(s, p);
+    }
+    // projection keeping the plane of the four points
+    for (auto axis = 0; axis < 3; ++axis) {
+      auto pp = project(p, axis), pq = project(q, axis);
+      auto pr = project(r, axis), ps = project(s, axis);
+      if (orient(pp, pq, pr) != 0 || orient(pp, pq, ps) != 0) {
+        return segments2d(pp, pq, pr, ps);
+      }
+    }
+    return false;  // unreachable for coplanar points off one line
+  }
+
+  static bool segmentTriangle(const Segment& seg,
+                              const Triangle3D<T>& t) noexcept {
+    auto&& p = *seg.p_, &q = *seg.q_;
+    auto sp = predicates::orient3d(t.a_, t.b_, t.c_, p);
+    auto sq = predicates::orient3d(t.a_, t.b_, t.c_, q);
+    if (sp * sq > 0) {
+      return false;
+    }
+    if (sp != 0 || sq != 0) {
+      // segment meets the plane in one point, it is inside iff the line
+      // passes the three edges on one side
+      int o[3] = {predicates::orient3d(p, q, t.a_, t.b_),
+                  predicates::orient3d(p, q, t.b_, t.c_),
+                  predicates::orient3d(p, q, t.c_, t.a_)};
+      auto neg = o[0] < 0 || o[1] < 0 || o[2] < 0;
+      auto pos = o[0] > 0 || o[1] > 0 || o[2] > 0;
+      return !(neg && pos);
+    }
+
+    auto axis = projectionAxis(t);
+    auto a = project(t.a_, axis), b = project(t.b_, axis),
+         c = project(t.c_, axis);
+    auto pp = project(p, axis), pq = project(q, axis);
+    if (inside2d(a, b, c, pp) || inside2d(a, b, c, pq)) {
+      return true;
+    }
+    if (seg.point()) {
+      return false;
+    }
+    return segments2d(pp, pq, a, b) || segments2d(pp, pq, b, c) ||
+           segments2d(pp, pq, c, a);
+  }
+
+  /**
+   * Coordinate plane where the projection of a proper triangle keeps its
+   * area, dominant axis of the normal first. The normal is estimated in
+   * double, so that integer coordinates do not overflow.
+   */
+  static int projectionAxis(const Triangle3D<T>& t) noexcept {
+    auto diff = [](const Point& a, const Point& b) {
+      return Vector3D<double>{double(a.x_) - b.x_, double(a.y_) - b.y_,
+                              double(a.z_) - b.z_};
+    };
+    auto n = crossProduct(diff(t.b_, t.a_), diff(t.c_, t.a_));
+    auto ax = std::abs(n.x_), ay = std::abs(n.y_), az = std::abs(n.z_);
+    auto dominant = ax >= ay && ax >= az ? 0 : ay >= az ? 1 : 2;
+    for (auto k = 0; k < 3; ++k) {
+      auto axis = (dominant + k) % 3;
+      // rounded normal may point to an exactly zero component
+      if (orient(project(t.a_, axis), project(t.b_, axis),
+                 project(t.c_, axis)) != 0) {
+        return axis;
+      }
+    }
+    return dominant;  // unreachable for a triangle that is not collinear
+  }
+
+  static bool inside2d(const Point2D& a, const Point2D& b, const Point2D& c,
+                       const Point2D& p) noexcept {
+    auto o = orient(a, b, c);
+    return orient(a, b, p) * o >= 0 && orient(b, c, p) * o >= 0 &&
+           orient(c, a, p) * o >= 0;
+  }
+
+  /** closed segments pq and rs, both of nonzero length */
+  static bool segments2d(const Point2D& p, const Point2D& q, const Point2D& r,
+                         const Point2D& s) noexcept {
+    auto o1 = orient(p, q, r), o2 = orient(p, q, s);
+    auto o3 = orient(r, s, p), o4 = orient(r, s, q);
+    if ((o1 == 0 && inBox(p, q, r)) || (o2 == 0 && inBox(p, q, s)) ||
+        (o3 == 0 && inBox(r, s, p)) || (o4 == 0 && inBox(r, s, q))) {
+      return true;
+    }
+    return o1 * o2 < 0 && o3 * o4 < 0;
+  }
+
+  static bool inBox(const Point2D& p, const Point2D& q,
+                    const Point2D& x) noexcept {
+    return std::min(p[0], q[0]) <= x[0] && x[0] <= std::max(p[0], q[0]) &&
+           std::min(p[1], q[1]) <= x[1] && x[1] <= std::max(p[1], q[1]);
+  }
+
+  static Point2D project(const Point& p, int axis) noexcept {
+    return axis == 0 ? Point2D{p.y_, p.z_}
+           : axis == 1 ? Point2D{p.z_, p.x_}
+                       : Point2D{p.x_, p.y_};
+  }
+
+  /**
+   * Both triangles lie on one plane and are not degenerate: projection to
+   * a coordinate plane where the first one keeps its area keeps the second
+   * one too.
+   */
+  static bool coplanar(const Triangle3D<T>& t1,
+                       const Triangle3D<T>& t2) noexcept {
+    auto axis = projectionAxis(t1);
+    return overlap2d(project(t1.a_, axis), project(t1.b_, axis),
+                     project(t1.c_, axis), project(t2.a_, axis),
+                     project(t2.b_, axis), project(t2.c_, axis));
+  }
+
+  static int orient(const Point2D& a, const Point2D& b,
+                    const Point2D& c) noexcept {
+    return predicates::orient2d(a, b, c);
+  }
+
+  static bool overlap2d(const Point2D& p1, const Point2D& q1,
+                        const Point2D& r1, const Point2D& p2,
+                        const Point2D& q2, const Point2D& r2) noexcept {
+    if (orient(p1, q1, r1) < 0) {
+      if (orient(p2, q2, r2) < 0) {
+        return counterclockwise(p1, r1, q1, p2, r2, q2);
+      }
+      return counterclockwise(p1, r1, q1, p2, q2, r2);
+    }
+    if (orient(p2, q2, r2) < 0) {
+      return counterclockwise(p1, q1, r1, p2, r2, q2);
+    }
+    return counterclockwise(p1, q1, r1, p2, q2, r2);
+  }
+
+  /**
+   * Both triangles counterclockwise, regions around the second one are
+   * found by the position of p1.
+   */
+  static bool counterclockwise(const Point2D& p1, const Point2D& q1,
+                               const Point2D& r1, const Point2D& p2,
+                               const Point2D& q2,
+                               const Point2D& r2) noexcept {
+    if (orient(p2, q2, p1) >= 0) {
+      if (orient(q2, r2, p1) >= 0) {
+        if (orient(r2, p2, p1) >= 0) {
+          return true;
+        }
+        return edge(p1, q1, r1, p2, q2, r2);
+      }
+      if (orient(r2, p2, p1) >= 0) {
+        return edge(p1, q1, r1, r2, p2, q2);
+      }
+      return vertex(p1, q1, r1, p2, q2, r2);
+    }
+    if (orient(q2, r2, p1) >= 0) {
+      if (orient(r2, p2, p1) >= 0) {
+        return edge(p1, q1, r1, q2, r2, p2);
+      }
+      return vertex(p1, q1, r1, q2, r2, p2);
+    }
+    return vertex(p1, q1, r1, r2, p2, q2);
+  }
+
+  /** p1 in the region facing vertex p2 */
+  static bool vertex(const Point2D& p1, const Point2D& q1, const Point2D& r1,
+                     const Point2D& p2, const Point2D& q2,
+                     const Point2D& r2) noexcept {
+    if (orient(r2, p2, q1) >= 0) {
+      if (orient(r2, q2, q1) <= 0) {
+        if (orient(p1, p2, q1) > 0) {
+          return orient(p1, q2, q1) <= 0;
+        }
+        return orient(p1, p2, r1) >= 0 && orient(q1, r1, p2) >= 0;
+      }
+      return orient(p1, q2, q1) <= 0 && orient(r2, q2, r1) <= 0 &&
+             orient(q1, r1, q2) >= 0;
+    }
+    if (orient(r2, p2, r1) >= 0) {
+      if (orient(q1, r1, r2) >= 0) {
+        return orient(p1, p2, r1) >= 0;
+      }
+      return orient(q1, r1, q2) >= 0 && orient(r2, r1, q2) >= 0;
+    }
+    return false;
+  }
+
+  /** p1 in the region facing edge p2 r2 */
+  static bool edge(const Point2D& p1, const Point2D& q1, const Point2D& r1,
+                   const Point2D& p2, const Point2D& /* q2 */,
+                   const Point2D& r2) noexcept {
+    if (orient(r2, p2, q1) >= 0) {
+      if (orient(p1, p2, q1) >= 0) {
+        return orient(p1, q1, r2) >= 0;
+      }
+      return orient(q1, r1, p2) >= 0 && orient(r1, p1, p2) >= 0;
+    }
+    if (orient(r2, p2, r1) >= 0) {
+      return orient(p1, p2, r1) >= 0 &&
+             (orient(p1, r1, r2) >= 0 || orient(q1, r1, r2) >= 0);
+    }
+    return false;
+  }
+};
+
+}  // namespace detail
+
+/**
+ * Exact triangle-triangle test: fast evaluation in T with a rigorous error
+ * bound, exact expansions only where the bound leaves a sign uncertain, and
+ * 128-bit integers for integer coordinates. Answers are those of exact
+ * arithmetic on the given coordinates, touching triangles intersect.
+ */
+template <typename T>
+bool intersectsExact(const Triangle3D<T>& t1,
+                     const Triangle3D<T>& t2) noexcept {
+  return detail::ExactIntersection<T>::test(t1, t2);
+}
+
+}  // namespace geometry
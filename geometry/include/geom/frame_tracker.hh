@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "narrow_phase.hh"
+#include "range3d.hh"
+#include "spdlog/spdlog.h"
+#include "triangle3d.hh"
+
+namespace geometry {
+
+/**
+ * Tracks intersections over a sequence of frames of the same triangles.
+ *
+ * Broad phase is an incremental sweep and prune along a single axis: the
+ * endpoints of the bounding boxes stay sorted between frames and are repaired
+ * with insertion sort, so every endpoint swap marks a pair whose boxes started
+ * or stopped overlapping. Narrow phase results are cached per candidate pair
+ * and recomputed only for new candidates and for candidates with a moved
+ * triangle, so the cost of update() scales with motion rather than scene size.
+ * Boxes are grown by the tolerance band of kernels, as in the octree, so
+ * pairs in contact within tolerance are candidates too.
+ */
+template <typename T>
+class FrameTracker final {
+  struct Endpoint final {
+    T value_;
+    std::uint32_t id_;
+    bool is_max_;
+
+    // min endpoints go first on ties so that touching boxes overlap
+    bool operator<(const Endpoint& other) const noexcept {
+      return value_ < other.value_ ||
+             (value_ == other.value_ && !is_max_ && other.is_max_);
+    }
+  };
+
+  struct PairState final {
+    bool intersects_ = false;
+    bool dirty_ = true;
+  };
+
+ public:
+  template <typename It,
+            typename = std::enable_if_t<std::is_base_of_v<
+                std::input_iterator_tag,
+                typename std::iterator_traits<It>::iterator_category>>>
+  FrameTracker(It begin, It end, NarrowPhase kernel = kDefaultNarrowPhase)
+      : triangles_(begin, end), narrow_phase_(kernel) {
+    auto count = triangles_.size();
+    assert(count <= UINT32_MAX);
+
+    ranges_.resize(count);
+    hits_.resize(count);
+    neighbours_.resize(count);
+    positions_.resize(2 * count);
+    for (std::size_t i = 0; i < count; ++i) {
+      ranges_[i] = paddedRange(triangles_[i]);
+    }
+
+    axis_ = chooseAxis();
+    endpoints_.reserve(2 * count);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      endpoints_.push_back({minOnAxis(i), i, false});
+      endpoints_.push_back({maxOnAxis(i), i, true});
+    }
+    std::sort(endpoints_.begin(), endpoints_.end());
+
+    // initial sweep: every box overlapping the open ones becomes candidate
+    std::vector<std::uint32_t> open;
+    for (std::size_t k = 0; k < endpoints_.size(); ++k) {
+      auto&& e = endpoints_[k];
+      positions_[slot(e)] = k;
+      if (e.is_max_) {
+        open.erase(std::find(open.begin(), open.end(), e.id_));
+        continue;
+      }
+      for (auto other : open) {
+        addCandidate(e.id_, other);
+      }
+      open.push_back(e.id_);
+    }
+
+    retestDirty();
+  }
+
+  /**
+   * Moves the scene to the next frame. Triangles are matched by their
+   * position in the sequence, so the count must stay the same.
+   */
+  template <typename It,
+            typename = std::enable_if_t<std::is_base_of_v<
+                std::input_iterator_tag,
+                typename std::iterator_traits<It>::iterator_category>>>
+  void update(It begin, It end) {
+    std::size_t i = 0;
+    for (; begin != end; ++i, ++begin) {
+      assert(i < triangles_.size());
+      if (std::memcmp(&triangles_[i], &*begin, sizeof(Triangle3D<T>)) == 0) {
+        continue;
+      }
+      triangles_[i] = *begin;
+      ranges_[i] = paddedRange(triangles_[i]);
+      endpoints_[positions_[2 * i]].value_ = minOnAxis(i);
+      endpoints_[positions_[2 * i + 1]].value_ = maxOnAxis(i);
+      moved_.push_back(i);
+    }
+    assert(i == triangles_.size());
+
+    resort();
+    for (auto id : moved_) {
+      for (auto other : neighbours_[id]) {
+        markDirty(id, other);
+      }
+    }
+    moved_.clear();
+    retestDirty();
+  }
+
+  const std::set<std::size_t>& getIntersections() const noexcept {
+    return result_;
+  }
+
+  auto size() const noexcept { return triangles_.size(); }
+
+  /** number of candidate pairs passed to narrow phase during last frame */
+  auto retested() const noexcept { return retested_; }
+  auto candidates() const noexcept { return pairs_.size(); }
+
+ private:
+  static std::uint64_t key(std::uint32_t a, std::uint32_t b) noexcept {
+    if (a > b) {
+      std::swap(a, b);
+    }
+    return (static_cast<std::uint64_t>(a) << 32) | b;
+  }
+
+  static std::size_t slot(const Endpoint& e) noexcept {
+    return 2 * static_cast<std::size_t>(e.id_) + e.is_max_;
+  }
+
+  /** axis with the widest spread of box centers */
+  unsigned chooseAxis() const noexcept {
+    if (ranges_.empty()) {
+      return 0;
+    }
+
+    std::array<T, 3> lo, hi;
+    lo.fill(std::numeric_limits<T>::max());
+    hi.fill(std::numeric_limits<T>::lowest());
+    for (auto&& r : ranges_) {
+      std::array<T, 3> center{r.min_x_ + r.max_x_, r.min_y_ + r.max_y_,
+                              r.min_z_ + r.max_z_};
+      for (auto a = 0; a < 3; ++a) {
+        lo[a] = std::min(lo[a], center[a]);
+        hi[a] = std::max(hi[a], center[a]);
+      }
+    }
+
+    unsigned best = 0;
+    for (unsigned a = 1; a < 3; ++a) {
+      if (hi[a] - lo[a] > hi[best] - lo[best]) {
+        best = a;
+      }
+    }
+    return best;
+  }
+
+  T minOnAxis(std::size_t id) const noexcept {
+    auto&& r = ranges_[id];
+    return axis_ == 0 ? r.min_x_ : axis_ == 1 ? r.min_y_ : r.min_z_;
+  }
+
+  T maxOnAxis(std::size_t id) const noexcept {
+    auto&& r = ranges_[id];
+    return axis_ == 0 ? r.max_x_ : axis_ == 1 ? r.max_y_ : r.max_z_;
+  }
+
+  /**
+   * Insertion sort of endpoints. Moving endpoint of one box over an endpoint
+   * of other box of the opposite kind toggles overlap of these boxes on axis.
+   */
+  void resort() {
+    for (std::size_t k = 1; k < endpoints_.size(); ++k) {
+      auto e = endpoints_[k];
+      auto j = k;
+      for (; j > 0 && e < endpoints_[j - 1]; --j) {
+        auto&& prev = endpoints_[j - 1];
+        if (prev.id_ != e.id_ && prev.is_max_ != e.is_max_) {
+          if (e.is_max_) {
+            removeCandidate(e.id_, prev.id_);
+          } else {
+            addCandidate(e.id_, prev.id_);
+          }
+        }
+        endpoints_[j] = prev;
+        positions_[slot(prev)] = j;
+      }
+      endpoints_[j] = e;
+      positions_[slot(e)] = j;
+    }
+  }
+
+  void addCandidate(std::uint32_t a, std::uint32_t b) {
+    auto [it, inserted] = pairs_.try_emplace(key(a, b));
+    if (!inserted) {
+      return;
+    }
+    neighbours_[a].push_back(b);
+    neighbours_[b].push_back(a);
+    dirty_.push_back(it->first);
+  }
+
+  void removeCandidate(std::uint32_t a, std::uint32_t b) {
+    auto it = pairs_.find(key(a, b));
+    if (it == pairs_.end()) {
+      return;
+    }
+    setIntersects(it->first, it->second, false);
+    pairs_.erase(it);
+    eraseNeighbour(a, b);
+    eraseNeighbour(b, a);
+  }
+
+  void eraseNeighbour(std::uint32_t id, std::uint32_t other) {
+    auto&& n = neighbours_[id];
+    auto it = std::find(n.begin(), n.end(), other);
+    assert(it != n.end());
+    *it = n.back();
+    n.pop_back();
+  }
+
+  void markDirty(std::uint32_t a, std::uint32_t b) {
+    auto&& state = pairs_[key(a, b)];
+    if (!state.dirty_) {
+      state.dirty_ = true;
+      dirty_.push_back(key(a, b));
+    }
+  }
+
+  void retestDirty() {
+    retested_ = 0;
+    for (auto k : dirty_) {
+      auto it = pairs_.find(k);
+      if (it == pairs_.end()) {
+        continue;  // stopped overlapping after being marked
+      }
+      auto&& state = it->second;
+      state.dirty_ = false;
+
+      auto a = static_cast<std::uint32_t>(k >> 32);
+      auto b = static_cast<std::uint32_t>(k);
+      auto res = false;
+      if (ranges_[a].overlaps(ranges_[b])) {
+        ++retested_;
+        res = intersects(triangles_[a], triangles_[b], narrow_phase_);
+      }
+      setIntersects(k, state, res);
+    }
+    dirty_.clear();
+  }
+
+  void setIntersects(std::uint64_t k, PairState& state, bool value) {
+    if (state.intersects_ == value) {
+      return;
+    }
+    state.intersects_ = value;
+
+    for (auto id : {static_cast<std::uint32_t>(k >> 32),
+                    static_cast<std::uint32_t>(k)}) {
+      if (value && hits_[id]++ == 0) {
+        result_.insert(id);
+      } else if (!value && --hits_[id] == 0) {
+        result_.erase(id);
+      }
+    }
+    SPDLOG_TRACE("Triangles {} and {} intersection status changed to {}",
+                 k >> 32, static_cast<std::uint32_t>(k), value);
+  }
+
+ private:
+  std::vector<Triangle3D<T>> triangles_;
+  NarrowPhase narrow_phase_;
+  std::vector<Range3D<T>> ranges_;  // grown by paddedRange()
+
+  unsigned axis_ = 0;
+  std::vector<Endpoint> endpoints_;
+  std::vector<std::size_t> positions_;  // endpoint index for each slot()
+
+  std::unordered_map<std::uint64_t, PairState> pairs_;
+  std::vector<std::vector<std::uint32_t>> neighbours_;
+  std::vector<std::uint64_t> dirty_;
+  std::vector<std::uint32_t> moved_;
+
+  std::vector<std::uint32_t> hits_;  // intersecting pairs per triangle
+  std::set<std::size_t> result_;
+  std::size_t retested_ = 0;
+};
+
+}  // namespace geometry
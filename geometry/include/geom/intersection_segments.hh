@@ -0,0 +1,332 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "parallel.hh"
+#include "prepared_triangle.hh"
+#include "segment3d.hh"
+#include "triangle3d.hh"
+
+namespace geometry {
+
+namespace detail {
+
+/**
+ * Part of proper triangle on a plane, from the points where its edges cross
+ * the plane and its vertices on the plane. Edge crossings are computed from
+ * the lexicographically smaller vertex, so triangles sharing an edge get
+ * the same point bit for bit.
+ */
+template <typename T>
+std::optional<Segment3D<T>> cutByPlane(const Triangle3D<T>& t,
+                                       const Plane<T>& p) noexcept {
+  const Vector3D<T>* v[3] = {&t.a_, &t.b_, &t.c_};
+  T d[3];
+  for (auto i = 0; i < 3; ++i) {
+    d[i] = p.contains(*v[i]) ? 0 : dot(*v[i], p.normal()) - p.distance();
+  }
+  auto zeros = (d[0] == 0) + (d[1] == 0) + (d[2] == 0);
+  if (zeros == 3 || (d[0] > 0 && d[1] > 0 && d[2] > 0) ||
+      (d[0] < 0 && d[1] < 0 && d[2] < 0)) {
+    return std::nullopt;
+  }
+
+  Vector3D<T> points[2];
+  auto count = 0;
+  for (auto i = 0; i < 3; ++i) {
+    if (d[i] == 0) {
+      points[count++] = *v[i];
+    }
+  }
+  for (auto i = 0; i < 3 && count < 2; ++i) {
+    auto j = (i + 1) % 3;
+    if ((d[i] < 0 && d[j] > 0) || (d[i] > 0 && d[j] < 0)) {
+      auto key = [](const Vector3D<T>* u) {
+        return std::tie(u->x_, u->y_, u->z_);
+      };
+      auto from = i, to = j;
+      if (key(v[to]) < key(v[from])) {
+        std::swap(from, to);
+      }
+      points[count++] =
+          *v[from] + (*v[to] - *v[from]) * (d[from] / (d[from] - d[to]));
+    }
+  }
+  // vertex touching the plane
+  if (count == 1) {
+    points[1] = points[0];
+  }
+  return Segment3D<T>{points[0], points[1]};
+}
+
+}  // namespace detail
+
+/**
+ * Segment where two proper triangles with crossing planes meet, both cuts
+ * lie on the line of the planes and the segment is their overlap. Touching
+ * triangles give a segment of zero length. Coplanar pairs meet in a polygon
+ * and degenerate triangles in a point or segment of their own, those give
+ * nullopt as they make no cut lines.
+ */
+template <typename T>
+std::optional<Segment3D<T>> intersectionSegment(
+    const PreparedTriangle<T>& t1, const PreparedTriangle<T>& t2) noexcept {
+  if (t1.degeneracy_ != Degeneracy::kNone ||
+      t2.degeneracy_ != Degeneracy::kNone || t1.coplanarWith(t2) ||
+      t1.plane_.isClose(t2.plane_)) {
+    return std::nullopt;
+  }
+  auto s1 = detail::cutByPlane(t1.triangle_, t2.plane_);
+  auto s2 = detail::cutByPlane(t2.triangle_, t1.plane_);
+  if (!s1 || !s2) {
+    return std::nullopt;
+  }
+
+  auto dir = crossProduct(t1.plane_.normal(), t2.plane_.normal());
+  auto at = [&dir](const Vector3D<T>& p) { return dot(dir, p); };
+  for (auto s : {&*s1, &*s2}) {
+    if (at(s->end_) < at(s->begin_)) {
+      std::swap(s->begin_, s->end_);
+    }
+  }
+  auto&& lo = at(s1->begin_) >= at(s2->begin_) ? s1->begin_ : s2->begin_;
+  auto&& hi = at(s1->end_) <= at(s2->end_) ? s1->end_ : s2->end_;
+  if (at(hi) < at(lo)) {
+    // cuts are apart, but within tolerance of kernels they still touch
+    if (lo.isClose(hi)) {
+      return Segment3D<T>{lo, lo};
+    }
+    return std::nullopt;
+  }
+  return Segment3D<T>{lo, hi};
+}
+
+/**
+ * Intersection segments of triangle pairs as structure of arrays, six
+ * coordinate lanes and indices of both triangles. Row k belongs to the k-th
+ * pair, so rows are filled from many threads without locks. Rows without a
+ * segment hold NaN until compact() drops them.
+ */
+template <typename T>
+class SegmentBuffer final {
+ public:
+  enum Lane { kX0, kY0, kZ0, kX1, kY1, kZ1, kLanes };
+
+  SegmentBuffer() = default;
+
+  void resize(std::size_t size) {
+    size_ = size;
+    data_.assign(kLanes * size, NAN);
+    first_.assign(size, 0);
+    second_.assign(size, 0);
+  }
+
+  std::size_t size() const noexcept { return size_; }
+
+  void set(std::size_t k, std::uint64_t i, std::uint64_t j,
+           const std::optional<Segment3D<T>>& s) noexcept {
+    first_[k] = i;
+    second_[k] = j;
+    if (!s) {
+      return;
+    }
+    T coords[kLanes] = {s->begin_.x_, s->begin_.y_, s->begin_.z_,
+                        s->end_.x_,   s->end_.y_,   s->end_.z_};
+    for (auto l = 0; l < kLanes; ++l) {
+      data_[l * size_ + k] = coords[l];
+    }
+  }
+
+  bool has(std::size_t k) const noexcept {
+    return !std::isnan(data_[kX0 * size_ + k]);
+  }
+
+  Segment3D<T> operator[](std::size_t k) const noexcept {
+    auto at = [this, k](Lane l) { return data_[l * size_ + k]; };
+    return {{at(kX0), at(kY0), at(kZ0)}, {at(kX1), at(kY1), at(kZ1)}};
+  }
+
+  const T* lane(Lane l) const noexcept { return data_.data() + l * size_; }
+  const std::uint64_t* first() const noexcept { return first_.data(); }
+  const std::uint64_t* second() const noexcept { return second_.data(); }
+
+  /**
+   * Drops rows without a segment, order of the rest is kept.
+   */
+  void compact() {
+    std::size_t kept = 0;
+    for (std::size_t k = 0; k < size_; ++k) {
+      if (has(k)) {
+        first_[kept] = first_[k];
+        second_[kept] = second_[k];
+        for (auto l = 0; l < kLanes; ++l) {
+          data_[l * size_ + kept] = data_[l * size_ + k];
+        }
+        ++kept;
+      }
+    }
+    // lanes move to the new stride one after another, each starts before
+    // its old position
+    for (auto l = 1; l < kLanes && kept != size_; ++l) {
+      std::copy(data_.begin() + l * size_, data_.begin() + l * size_ + kept,
+                data_.begin() + l * kept);
+    }
+    size_ = kept;
+    data_.resize(kLanes * kept);
+    first_.resize(kept);
+    second_.resize(kept);
+  }
+
+  /**
+   * Replaces triangle indices i with f(i).
+   */
+  template <typename F>
+  void renumber(F f) {
+    for (std::size_t k = 0; k < size_; ++k) {
+      first_[k] = f(first_[k]);
+      second_[k] = f(second_[k]);
+    }
+  }
+
+ private:
+  std::vector<T> data_;
+  std::vector<std::uint64_t> first_, second_;
+  std::size_t size_ = 0;
+};
+
+/**
+ * Fills out with intersection segments of pairs, computed on given number
+ * of threads, pairs without a segment are dropped. prepared maps indices of
+ * pairs to prepared triangles, as Octree::preparedByIndex() gives them, so
+ * planes are not built again for every pair.
+ */
+template <typename T>
+void extractSegments(const std::vector<const PreparedTriangle<T>*>& prepared,
+                     const std::vector<std::pair<std::size_t, std::size_t>>&
+                         pairs,
+                     SegmentBuffer<T>& out, unsigned threads = 1) {
+  // pairs go to threads in chunks, so rows of one thread share cache lines
+  constexpr std::size_t kChunk = 256;
+  out.resize(pairs.size());
+  parallelFor((pairs.size() + kChunk - 1) / kChunk, threads,
+              [&prepared, &pairs, &out](std::size_t c, unsigned) {
+                auto end = std::min(pairs.size(), (c + 1) * kChunk);
+                for (auto k = c * kChunk; k < end; ++k) {
+                  auto [i, j] = pairs[k];
+                  out.set(k, i, j,
+                          intersectionSegment(*prepared[i], *prepared[j]));
+                }
+              });
+  out.compact();
+}
+
+/**
+ * Polylines stored as points with offsets of polylines in them, closed
+ * ones repeat their first point at the end.
+ */
+template <typename T>
+struct Polylines final {
+  std::vector<Vector3D<T>> points_;
+  std::vector<std::size_t> offsets_ = {0};
+
+  std::size_t size() const noexcept { return offsets_.size() - 1; }
+};
+
+/**
+ * Chains segments with equal endpoints into polylines. Chains end where
+ * other than two segments meet, what is left then are closed loops.
+ * Segments of zero length are skipped.
+ */
+template <typename T>
+Polylines<T> weldPolylines(const SegmentBuffer<T>& segments) {
+  // endpoint 2k is the begin of k-th segment, 2k + 1 is its end
+  std::vector<std::size_t> kept;
+  std::vector<Vector3D<T>> ends;
+  for (std::size_t k = 0; k < segments.size(); ++k) {
+    auto s = segments[k];
+    if (std::tie(s.begin_.x_, s.begin_.y_, s.begin_.z_) !=
+        std::tie(s.end_.x_, s.end_.y_, s.end_.z_)) {
+      kept.push_back(k);
+      ends.push_back(s.begin_);
+      ends.push_back(s.end_);
+    }
+  }
+
+  std::vector<std::uint32_t> order(ends.size());
+  for (std::size_t e = 0; e < ends.size(); ++e) {
+    order[e] = e;
+  }
+  auto key = [&ends](auto e) {
+    return std::tie(ends[e].x_, ends[e].y_, ends[e].z_);
+  };
+  std::sort(order.begin(), order.end(),
+            [&key](auto l, auto r) { return key(l) < key(r); });
+  std::vector<std::uint32_t> vertex(ends.size());
+  std::uint32_t vertices = 0;
+  for (std::size_t e = 0; e < order.size(); ++e) {
+    if (e != 0 && key(order[e]) != key(order[e - 1])) {
+      ++vertices;
+    }
+    vertex[order[e]] = vertices;
+  }
+  vertices += !order.empty();
+
+  // endpoints grouped by vertex, sort order already groups them
+  std::vector<std::size_t> offsets(vertices + 1, 0);
+  for (auto v : vertex) {
+    ++offsets[v + 1];
+  }
+  for (std::size_t v = 0; v < vertices; ++v) {
+    offsets[v + 1] += offsets[v];
+  }
+  auto degree = [&offsets](auto v) { return offsets[v + 1] - offsets[v]; };
+
+  Polylines<T> res;
+  std::vector<bool> used(kept.size());
+  // walks from endpoint e over its segment and on while the path is simple
+  auto walk = [&](std::uint32_t e) {
+    res.points_.push_back(ends[e]);
+    for (;;) {
+      used[e / 2] = true;
+      auto other = e ^ 1;
+      res.points_.push_back(ends[other]);
+      auto v = vertex[other];
+      if (degree(v) != 2) {
+        break;
+      }
+      auto first = order[offsets[v]], second = order[offsets[v] + 1];
+      auto next = first == other ? second : first;
+      if (used[next / 2]) {
+        break;
+      }
+      e = next;
+    }
+    res.offsets_.push_back(res.points_.size());
+  };
+
+  for (std::uint32_t v = 0; v < vertices; ++v) {
+    if (degree(v) == 2) {
+      continue;
+    }
+    for (auto o = offsets[v]; o < offsets[v + 1]; ++o) {
+      if (!used[order[o] / 2]) {
+        walk(order[o]);
+      }
+    }
+  }
+  for (std::uint32_t s = 0; s < kept.size(); ++s) {
+    if (!used[s]) {
+      walk(2 * s);
+    }
+  }
+  return res;
+}
+
+}  // namespace geometry
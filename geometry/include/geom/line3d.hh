@@ -2,6 +2,7 @@
 
 #include <cassert>
 
+#include "packed_vector3d.hh"
 #include "vector3d.hh"
 
 namespace geometry {
@@ -13,7 +14,10 @@ class Line3D final {
  public:
   Line3D() {}
   Line3D(const Vector3D<T>& direction, const Vector3D<T>& origin) noexcept
-      : direction_(Vector3D(direction).normalize()), origin_(origin) {}
+      : Line3D(PackedVector3D<T>(direction), origin) {}
+  Line3D(const PackedVector3D<T>& direction, const Vector3D<T>& origin) noexcept
+      : direction_(PackedVector3D<T>(direction).normalize().unpack()),
+        origin_(origin) {}
 
   // getters
  public:
@@ -23,32 +27,37 @@ class Line3D final {
  public:
   bool valid() const noexcept { return direction_.valid() && origin_.valid(); }
   bool contains(const Vector3D<T>& p) const noexcept {
-    return collinear(p - origin_, direction_);
+    return collinear(Packed(p) - Packed(origin_), Packed(direction_));
   }
 
   Vector3D<T> getIntersectionPoint(const Line3D<T>& other) const noexcept {
-    auto w = other.origin_ - origin_;
+    Packed dir(direction_), other_dir(other.direction_);
+    auto w = Packed(other.origin_) - Packed(origin_);
     // looks like we have to handle skew case explicitly
-    auto triple = tripleProduct(direction_, other.direction_, w);
+    auto triple = tripleProduct(dir, other_dir, w);
     if (!comparator::isClose(triple, static_cast<T>(0))) {
       return Vector3D<T>{};
     }
 
-    auto dir_cross = crossProduct(direction_, other.direction_);
-    if (dir_cross.isClose(Vector3D<T>::nullVector())) {
+    auto dir_cross = crossProduct(dir, other_dir);
+    if (dir_cross.isClose(Packed::nullVector())) {
       return Vector3D<T>{};
     }
 
-    auto numerator = dot(crossProduct(w, other.direction_), dir_cross);
+    auto numerator = dot(crossProduct(w, other_dir), dir_cross);
     auto t = numerator / dir_cross.norm2();
-    auto res = origin_ + direction_ * t;
-    return res;
+    auto res = Packed(origin_) + dir * t;
+    return res.unpack();
   }
 
   bool isClose(const Line3D<T>& other) const noexcept {
-    return collinear(direction_, other.direction_) &&
-           collinear(origin_ - other.origin_, direction_);
+    Packed dir(direction_);
+    return collinear(dir, Packed(other.direction_)) &&
+           collinear(Packed(origin_) - Packed(other.origin_), dir);
   }
+
+ private:
+  using Packed = PackedVector3D<T>;
 };
 
 }  // namespace geometry
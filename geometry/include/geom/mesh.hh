@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "triangle3d.hh"
+
+namespace geometry {
+
+/** vertex ids of a mesh triangle, equal ids are one vertex */
+using VertexIds = std::array<std::uint32_t, 3>;
+
+/** vertex id of triangles outside of any mesh */
+inline constexpr auto kNoVertex = std::numeric_limits<std::uint32_t>::max();
+
+/**
+ * Gives equal ids to vertices with equal coordinates, which turns triangle
+ * soup into a mesh. Ids are dense, vertices with NaN or infinite coordinates
+ * are never welded.
+ */
+template <typename It>
+std::vector<VertexIds> weldVertices(It begin, It end) {
+  std::vector<VertexIds> res(std::distance(begin, end));
+
+  using Point = std::remove_cv_t<std::remove_reference_t<decltype(begin->a_)>>;
+  struct Entry final {
+    const Point* point;
+    std::uint32_t* id;
+  };
+  std::vector<Entry> entries;
+  entries.reserve(3 * res.size());
+  std::uint32_t next = 0;
+  for (auto ids = res.begin(); begin != end; ++begin, ++ids) {
+    const Point* points[3] = {&begin->a_, &begin->b_, &begin->c_};
+    for (auto i = 0; i < 3; ++i) {
+      if (points[i]->valid()) {
+        entries.push_back({points[i], &(*ids)[i]});
+      } else {
+        (*ids)[i] = next++;
+      }
+    }
+  }
+
+  auto key = [](const Point& p) { return std::tie(p.x_, p.y_, p.z_); };
+  std::sort(entries.begin(), entries.end(), [&key](auto&& l, auto&& r) {
+    return key(*l.point) < key(*r.point);
+  });
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    if (i != 0 && key(*entries[i].point) != key(*entries[i - 1].point)) {
+      ++next;
+    }
+    *entries[i].id = next;
+  }
+  return res;
+}
+
+/**
+ * Triangles over a shared pool of vertices: a closed mesh has about half as
+ * many vertices as triangles, so each vertex is stored once instead of six
+ * times. Faces hold indices into vertices_, equal indices are one vertex.
+ */
+template <typename T>
+struct IndexedMesh final {
+  std::vector<Vector3D<T>> vertices_;
+  std::vector<VertexIds> faces_;
+
+  std::size_t size() const noexcept { return faces_.size(); }
+
+  Triangle3D<T> operator[](std::size_t i) const noexcept {
+    auto&& f = faces_[i];
+    return {vertices_[f[0]], vertices_[f[1]], vertices_[f[2]]};
+  }
+
+  /** all faces refer to existing vertices */
+  bool valid() const noexcept {
+    return std::all_of(faces_.begin(), faces_.end(), [this](auto&& f) {
+      return std::all_of(f.begin(), f.end(),
+                         [this](auto v) { return v < vertices_.size(); });
+    });
+  }
+};
+
+/**
+ * Turns triangle soup into an indexed mesh, vertices are welded by
+ * weldVertices().
+ */
+template <typename It>
+auto weldMesh(It begin, It end) {
+  using Point = std::remove_cv_t<std::remove_reference_t<decltype(begin->a_)>>;
+  IndexedMesh<std::remove_cv_t<decltype(Point::x_)>> res;
+  res.faces_ = weldVertices(begin, end);
+
+  std::uint32_t count = 0;
+  for (auto&& f : res.faces_) {
+    count = std::max({count, f[0] + 1, f[1] + 1, f[2] + 1});
+  }
+  res.vertices_.resize(count);
+  for (auto f = res.faces_.begin(); begin != end; ++begin, ++f) {
+    res.vertices_[(*f)[0]] = begin->a_;
+    res.vertices_[(*f)[1]] = begin->b_;
+    res.vertices_[(*f)[2]] = begin->c_;
+  }
+  return res;
+}
+
+}  // namespace geometry
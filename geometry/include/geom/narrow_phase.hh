@@ -0,0 +1,519 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <utility>
+
+#include "comparator.hh"
+#include "exact_intersection.hh"
+#include "prepared_triangle.hh"
+#include "triangle3d.hh"
+
+namespace geometry {
+
+/**
+ * Triangle-triangle intersection kernels.
+ */
+enum class NarrowPhase {
+  kGeneric,   // Triangle3D::intersects
+  kInterval,  // signed distances and interval overlap, generic on ambiguity
+  kExact,     // exact orientation predicates, no tolerance
+  kMixed,     // interval on stored precision, generic in double on ambiguity
+};
+
+#ifdef GEOMETRY_GENERIC_NARROW_PHASE
+inline constexpr auto kDefaultNarrowPhase = NarrowPhase::kGeneric;
+#else
+inline constexpr auto kDefaultNarrowPhase = NarrowPhase::kInterval;
+#endif
+
+namespace detail {
+
+/**
+ * Signed distances of triangle vertices to a plane, scaled by the length of
+ * unnormalized plane normal, together with the band where the sign is not
+ * trusted.
+ */
+template <typename T>
+struct PlaneSides final {
+  T d_[3];
+  T band2_;  // squared half-width of the uncertain band
+
+  bool inBand(int i) const noexcept { return d_[i] * d_[i] <= band2_; }
+  bool anyInBand() const noexcept {
+    return inBand(0) || inBand(1) || inBand(2);
+  }
+  bool oneSide() const noexcept {
+    return (d_[0] > 0 && d_[1] > 0 && d_[2] > 0) ||
+           (d_[0] < 0 && d_[1] < 0 && d_[2] < 0);
+  }
+};
+
+/**
+ * Unnormalized normal of the triangle together with a bound of its rounding
+ * error, which for slivers is much larger than the normal itself.
+ */
+template <typename T>
+struct RawPlane final {
+  Vector3D<T> n_;
+  T err_;  // >= |e1| * |e2|, no sqrt needed
+
+  explicit RawPlane(const Triangle3D<T>& t) noexcept {
+    auto e1 = t.b_ - t.a_;
+    auto e2 = t.c_ - t.a_;
+    n_ = crossProduct(e1, e2);
+    err_ = (e1.norm2() + e2.norm2()) / 2;
+  }
+
+  explicit RawPlane(const PreparedTriangle<T>& t) noexcept
+      : n_(t.raw_normal_), err_(t.raw_normal_err_) {}
+
+  bool valid() const noexcept {
+    auto n2 = n_.norm2();
+    return n2 > 0 && std::isfinite(n2);
+  }
+
+  /**
+   * band is the tolerance in distance units, scale bounds vertex coordinates.
+   */
+  PlaneSides<T> sides(const Triangle3D<T>& plane_triangle,
+                      const Triangle3D<T>& t, T band, T scale) const noexcept {
+    constexpr auto kEps = std::numeric_limits<T>::epsilon();
+    auto&& origin = plane_triangle.a_;
+    // band of comparator tolerance plus rounding of normal and dot products
+    auto tol = band * band * n_.norm2();
+    auto rounding = 16 * kEps * err_ * scale;
+    return {{dot(n_, t.a_ - origin), dot(n_, t.b_ - origin),
+             dot(n_, t.c_ - origin)},
+            2 * (tol + rounding * rounding)};
+  }
+};
+
+/**
+ * Interval cut from line of planes intersection by the triangle, as
+ * coordinates on dominant axis of the line, with error bound.
+ */
+template <typename T>
+struct LineInterval final {
+  T lo_, hi_;
+  T err_;
+};
+
+template <typename T>
+LineInterval<T> lineInterval(const Triangle3D<T>& t, const PlaneSides<T>& s,
+                             int axis, T scale) noexcept {
+  const Vector3D<T>* v[3] = {&t.a_, &t.b_, &t.c_};
+  auto coord = [axis](const Vector3D<T>& p) {
+    return axis == 0 ? p.x_ : axis == 1 ? p.y_ : p.z_;
+  };
+
+  // vertex alone on its side of the other plane
+  auto lone = (s.d_[0] > 0) == (s.d_[1] > 0) ? 2
+              : (s.d_[0] > 0) == (s.d_[2] > 0) ? 1
+                                               : 0;
+  auto p = coord(*v[lone]);
+  auto dl = s.d_[lone];
+
+  constexpr auto kEps = std::numeric_limits<T>::epsilon();
+  auto band = std::sqrt(s.band2_);
+  LineInterval<T> res{std::numeric_limits<T>::max(),
+                      std::numeric_limits<T>::lowest(), 0};
+  for (auto other : {(lone + 1) % 3, (lone + 2) % 3}) {
+    auto q = coord(*v[other]);
+    auto denom = dl - s.d_[other];  // signs differ, no cancellation
+    auto x = p + (q - p) * (dl / denom);
+    res.lo_ = std::min(res.lo_, x);
+    res.hi_ = std::max(res.hi_, x);
+    // distances are known up to band, that much shifts the ratio
+    res.err_ = std::max(res.err_,
+                        std::abs(q - p) * 2 * band / std::abs(denom) +
+                            8 * kEps * scale);
+  }
+  return res;
+}
+
+/**
+ * Body of interval test, scale bounds coordinates of both triangles and
+ * fallback() runs the generic kernel.
+ */
+template <typename T, typename F>
+bool intersectsInterval(const Triangle3D<T>& t1, const RawPlane<T>& p1,
+                        const Triangle3D<T>& t2, const RawPlane<T>& p2,
+                        T scale, F fallback) noexcept {
+  if (!p1.valid() || !p2.valid()) {
+    return fallback();
+  }
+
+  // Plane::contains tolerance with a margin for rounding of both kernels
+  auto band = comparator::kernelBand(scale);
+
+  auto s1 = p2.sides(t2, t1, band, scale);
+  if (s1.oneSide() && !s1.anyInBand()) {
+    return false;
+  }
+  auto s2 = p1.sides(t1, t2, band, scale);
+  if (s2.oneSide() && !s2.anyInBand()) {
+    return false;
+  }
+  if (s1.anyInBand() || s2.anyInBand()) {
+    return fallback();
+  }
+
+  auto dir = crossProduct(p1.n_, p2.n_);
+  auto ax = std::abs(dir.x_), ay = std::abs(dir.y_), az = std::abs(dir.z_);
+  auto axis = ax >= ay && ax >= az ? 0 : ay >= az ? 1 : 2;
+  if (std::max({ax, ay, az}) == 0) {
+    return fallback();
+  }
+
+  auto i1 = lineInterval(t1, s1, axis, scale);
+  auto i2 = lineInterval(t2, s2, axis, scale);
+  auto overlap = std::min(i1.hi_, i2.hi_) - std::max(i1.lo_, i2.lo_);
+  auto margin = i1.err_ + i2.err_ + band;
+  if (overlap > margin) {
+    return true;
+  }
+  if (overlap < -margin) {
+    return false;
+  }
+  return fallback();
+}
+
+template <typename T>
+Triangle3D<double> widen(const Triangle3D<T>& t) noexcept {
+  auto v = [](const Vector3D<T>& p) {
+    return Vector3D<double>{p.x_, p.y_, p.z_};
+  };
+  return {v(t.a_), v(t.b_), v(t.c_)};
+}
+
+}  // namespace detail
+
+/**
+ * Interval overlap test in the spirit of Moller's triangle-triangle test.
+ *
+ * Signed distances of vertices of each triangle to the plane of the other
+ * one reject most pairs with sign tests alone. Otherwise both triangles cut
+ * a segment from the line where their planes meet, and they intersect iff
+ * these segments overlap. Whenever a decision falls within tolerance
+ * (touching, coplanar or degenerate triangles) the pair is passed to the
+ * generic kernel, so results keep its tolerance semantics.
+ */
+template <typename T>
+bool intersectsInterval(const Triangle3D<T>& t1,
+                        const Triangle3D<T>& t2) noexcept {
+  auto scale = T{0};
+  for (auto t : {&t1, &t2}) {
+    for (auto v : {&t->a_, &t->b_, &t->c_}) {
+      scale = std::max({scale, std::abs(v->x_), std::abs(v->y_),
+                        std::abs(v->z_)});
+    }
+  }
+  return detail::intersectsInterval(
+      t1, detail::RawPlane<T>(t1), t2, detail::RawPlane<T>(t2), scale,
+      [&t1, &t2] { return t1.intersects(t2); });
+}
+
+namespace detail {
+
+/**
+ * Projection of a proper triangle to a coordinate plane together with the
+ * edge tolerance of Triangle3D::contains().
+ */
+template <typename T>
+struct ProjectedTriangle final {
+  using Point = std::array<T, 2>;
+
+  Point v_[3];
+  T sign_;  // orientation of the projection
+  T tol_;
+
+  /**
+   * axis is dropped, (u, v, axis) is a cyclic permutation of (x, y, z).
+   */
+  ProjectedTriangle(const PreparedTriangle<T>& t, int axis) noexcept {
+    constexpr auto kEps = std::numeric_limits<T>::epsilon();
+    constexpr auto kRel = comparator::kRelTol<T>;
+    constexpr auto kAbs = comparator::kAbsTol<T>;
+    auto project = [axis](const Vector3D<T>& p) {
+      return axis == 0   ? Point{p.y_, p.z_}
+             : axis == 1 ? Point{p.z_, p.x_}
+                         : Point{p.x_, p.y_};
+    };
+    auto&& tr = t.triangle_;
+    v_[0] = project(tr.a_);
+    v_[1] = project(tr.b_);
+    v_[2] = project(tr.c_);
+
+    auto doubled = cross(v_[0], v_[1], v_[2]);
+    sign_ = doubled < 0 ? -1 : 1;
+    auto&& n = t.plane_.normal();
+    auto n_k = std::abs(axis == 0 ? n.x_ : axis == 1 ? n.y_ : n.z_);
+    auto extent = std::abs(v_[1][0] - v_[0][0]) +
+                  std::abs(v_[1][1] - v_[0][1]) +
+                  std::abs(v_[2][0] - v_[0][0]) + std::abs(v_[2][1] - v_[0][1]);
+    tol_ = std::max(kRel * std::abs(doubled) / 2, kAbs * n_k) +
+           16 * kEps * extent * extent;
+  }
+
+  static T cross(const Point& from, const Point& to, const Point& p) noexcept {
+    return (to[0] - from[0]) * (p[1] - from[1]) -
+           (to[1] - from[1]) * (p[0] - from[0]);
+  }
+
+  /**
+   * Whether all points lie beyond one edge by more than tolerance.
+   */
+  bool separates(const Point (&p)[3]) const noexcept {
+    for (auto i = 0; i < 3; ++i) {
+      auto&& from = v_[i];
+      auto&& to = v_[(i + 1) % 3];
+      auto beyond = [&](const Point& q) {
+        return sign_ * cross(from, to, q) < -tol_;
+      };
+      if (beyond(p[0]) & beyond(p[1]) & beyond(p[2])) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/**
+ * Coplanar proper triangles, projected once to the coordinate plane of the
+ * dominant axis of the first normal. Two triangles are apart iff all
+ * vertices of one lie beyond an edge of the other, tolerance of edges is
+ * the one of point containment, so touching pairs intersect as in the
+ * generic kernel.
+ */
+template <typename T>
+bool intersectsCoplanar(const PreparedTriangle<T>& t1,
+                        const PreparedTriangle<T>& t2) noexcept {
+  ProjectedTriangle<T> p1(t1, t1.dominant_axis_);
+  ProjectedTriangle<T> p2(t2, t1.dominant_axis_);
+  return !p1.separates(p2.v_) && !p2.separates(p1.v_);
+}
+
+/**
+ * Branch of Triangle3D::intersects for one combination of degeneracies,
+ * chosen at compile time. Planes come from the prepared triangles,
+ * coplanar groups skip the comparison of planes and coplanar pairs take the
+ * 2D kernel.
+ */
+template <Degeneracy A, Degeneracy B, typename T>
+bool intersectsClassified(const PreparedTriangle<T>& t1,
+                          const PreparedTriangle<T>& t2) noexcept {
+  constexpr auto kProper = Degeneracy::kNone;
+  if constexpr (A == kProper && B == kProper) {
+    if (t1.coplanarWith(t2) || t1.plane_.isClose(t2.plane_)) {
+      return intersectsCoplanar(t1, t2);
+    }
+    return t1.triangle_.intersectsCrossing(t2.triangle_, t1.plane_,
+                                           t2.plane_);
+  } else if constexpr (A != kProper && B == kProper) {
+    return intersectsClassified<B, A>(t2, t1);
+  } else if constexpr (A == kProper && B == Degeneracy::kPoint) {
+    // point off the plane has no intersection point with it
+    auto seg = t2.segment();
+    auto&& p = seg.begin_;
+    if (!t1.plane_.contains(p)) {
+      return false;
+    }
+    return t1.triangle_.contains(p, t1.plane_) ||
+           t1.triangle_.intersectsEdges(seg);
+  } else if constexpr (A == kProper) {
+    auto seg = t2.segment();
+    if (t1.plane_.contains(seg)) {
+      return t1.triangle_.intersectsInPlane(seg, t1.plane_);
+    }
+    return t1.triangle_.contains(t1.plane_.getIntersectionPoint(seg),
+                                 t1.plane_);
+  } else if constexpr (A == Degeneracy::kPoint && B == Degeneracy::kPoint) {
+    return t1.segment().begin_.isClose(t2.segment().begin_);
+  } else {
+    return t1.segment().intersects(t2.segment());
+  }
+}
+
+}  // namespace detail
+
+/**
+ * Generic kernel on prepared triangles, planes are not rebuilt and
+ * degeneracy classes pick the branch without testing planes.
+ */
+template <typename T>
+bool intersectsGeneric(const PreparedTriangle<T>& t1,
+                       const PreparedTriangle<T>& t2) noexcept {
+  using detail::intersectsClassified;
+  constexpr auto kNone = Degeneracy::kNone;
+  constexpr auto kSegment = Degeneracy::kSegment;
+  constexpr auto kPoint = Degeneracy::kPoint;
+
+  if (t1.degeneracy_ == kNone && t2.degeneracy_ == kNone) {
+    return intersectsClassified<kNone, kNone>(t1, t2);
+  }
+  switch (static_cast<int>(t1.degeneracy_) * 3 +
+          static_cast<int>(t2.degeneracy_)) {
+    case 1:
+      return intersectsClassified<kNone, kSegment>(t1, t2);
+    case 2:
+      return intersectsClassified<kNone, kPoint>(t1, t2);
+    case 3:
+      return intersectsClassified<kSegment, kNone>(t1, t2);
+    case 4:
+      return intersectsClassified<kSegment, kSegment>(t1, t2);
+    case 5:
+      return intersectsClassified<kSegment, kPoint>(t1, t2);
+    case 6:
+      return intersectsClassified<kPoint, kNone>(t1, t2);
+    case 7:
+      return intersectsClassified<kPoint, kSegment>(t1, t2);
+    default:
+      break;
+  }
+  return intersectsClassified<kPoint, kPoint>(t1, t2);
+}
+
+template <typename T>
+bool intersectsInterval(const PreparedTriangle<T>& t1,
+                        const PreparedTriangle<T>& t2) noexcept {
+  if (t1.coplanarWith(t2)) {
+    return intersectsGeneric(t1, t2);  // every distance is in the band
+  }
+  return detail::intersectsInterval(
+      t1.triangle_, detail::RawPlane<T>(t1), t2.triangle_,
+      detail::RawPlane<T>(t2), std::max(t1.scale_, t2.scale_),
+      [&t1, &t2] { return intersectsGeneric(t1, t2); });
+}
+
+template <typename T>
+bool intersectsExact(const PreparedTriangle<T>& t1,
+                     const PreparedTriangle<T>& t2) noexcept {
+  return intersectsExact(t1.triangle_, t2.triangle_);
+}
+
+/**
+ * Interval kernel in the stored precision, pairs it leaves within tolerance
+ * of the decision are widened to double for the generic kernel. Float
+ * scenes get answers of the double kernel while keeping float storage, and
+ * only the few near-touching pairs pay for double arithmetic.
+ */
+template <typename T>
+bool intersectsMixed(const Triangle3D<T>& t1,
+                     const Triangle3D<T>& t2) noexcept {
+  auto scale = T{0};
+  for (auto t : {&t1, &t2}) {
+    for (auto v : {&t->a_, &t->b_, &t->c_}) {
+      scale = std::max({scale, std::abs(v->x_), std::abs(v->y_),
+                        std::abs(v->z_)});
+    }
+  }
+  return detail::intersectsInterval(
+      t1, detail::RawPlane<T>(t1), t2, detail::RawPlane<T>(t2), scale,
+      [&t1, &t2] { return detail::widen(t1).intersects(detail::widen(t2)); });
+}
+
+template <typename T>
+bool intersectsMixed(const PreparedTriangle<T>& t1,
+                     const PreparedTriangle<T>& t2) noexcept {
+  if (t1.coplanarWith(t2)) {
+    return detail::widen(t1.triangle_).intersectsInPlane(
+        detail::widen(t2.triangle_));
+  }
+  return detail::intersectsInterval(
+      t1.triangle_, detail::RawPlane<T>(t1), t2.triangle_,
+      detail::RawPlane<T>(t2), std::max(t1.scale_, t2.scale_), [&t1, &t2] {
+        return detail::widen(t1.triangle_).intersects(
+            detail::widen(t2.triangle_));
+      });
+}
+
+template <typename T>
+bool intersects(const Triangle3D<T>& t1, const Triangle3D<T>& t2,
+                NarrowPhase kernel = kDefaultNarrowPhase) noexcept {
+  switch (kernel) {
+    case NarrowPhase::kInterval:
+      return intersectsInterval(t1, t2);
+    case NarrowPhase::kExact:
+      return intersectsExact(t1, t2);
+    case NarrowPhase::kMixed:
+      return intersectsMixed(t1, t2);
+    case NarrowPhase::kGeneric:
+      break;
+  }
+  return t1.intersects(t2);
+}
+
+/**
+ * Mesh mode test of triangles with common vertex ids. Such triangles touch
+ * at the common vertex or edge by construction, so they intersect only if
+ * they meet anywhere else, which is decided exactly. Empty for triangles
+ * without common ids and for degenerate ones, those are left to kernels.
+ */
+template <typename T>
+std::optional<bool> intersectsAdjacent(const PreparedTriangle<T>& t1,
+                                       const PreparedTriangle<T>& t2) noexcept {
+  auto&& v1 = t1.vertices_;
+  auto&& v2 = t2.vertices_;
+  if (v1[0] == kNoVertex || v2[0] == kNoVertex) {
+    return std::nullopt;
+  }
+  // common[i] is the position of i-th vertex of t1 in t2, -1 if none
+  int common[3];
+  int count = 0;
+  for (auto i = 0; i < 3; ++i) {
+    auto it = std::find(v2.begin(), v2.end(), v1[i]);
+    common[i] = it == v2.end() ? -1 : it - v2.begin();
+    count += common[i] >= 0;
+  }
+  if (count == 0 || t1.degeneracy_ != Degeneracy::kNone ||
+      t2.degeneracy_ != Degeneracy::kNone) {
+    return std::nullopt;
+  }
+  if (count == 3) {
+    return true;
+  }
+
+  auto&& a = t1.triangle_;
+  auto&& b = t2.triangle_;
+  const Vector3D<T>* p1[3] = {&a.a_, &a.b_, &a.c_};
+  const Vector3D<T>* p2[3] = {&b.a_, &b.b_, &b.c_};
+  // rotate t1 so that common vertices go first, then t2 the same way
+  auto first = count == 1 ? (common[0] >= 0 ? 0 : common[1] >= 0 ? 1 : 2)
+                          : (common[0] < 0 ? 1 : common[1] < 0 ? 2 : 0);
+  Triangle3D<T> r1{*p1[first], *p1[(first + 1) % 3], *p1[(first + 2) % 3]};
+  auto shared = [&common, first](int k) { return common[(first + k) % 3]; };
+  if (count == 1) {
+    // remaining two vertices of t2 in any order
+    Triangle3D<T> r2{r1.a_, *p2[(shared(0) + 1) % 3],
+                     *p2[(shared(0) + 2) % 3]};
+    return detail::ExactIntersection<T>::beyondVertex(r1, r2);
+  }
+  // positions in t2 sum up to 3
+  Triangle3D<T> r2{r1.a_, r1.b_, *p2[3 - shared(0) - shared(1)]};
+  return detail::ExactIntersection<T>::beyondEdge(r1, r2);
+}
+
+template <typename T>
+bool intersects(const PreparedTriangle<T>& t1, const PreparedTriangle<T>& t2,
+                NarrowPhase kernel = kDefaultNarrowPhase) noexcept {
+  if (auto adjacent = intersectsAdjacent(t1, t2)) {
+    return *adjacent;
+  }
+  switch (kernel) {
+    case NarrowPhase::kInterval:
+      return intersectsInterval(t1, t2);
+    case NarrowPhase::kExact:
+      return intersectsExact(t1, t2);
+    case NarrowPhase::kMixed:
+      return intersectsMixed(t1, t2);
+    case NarrowPhase::kGeneric:
+      break;
+  }
+  return intersectsGeneric(t1, t2);
+}
+
+}  // namespace geometry
@@ -1,24 +1,58 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <bitset>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <iterator>
-#include <list>
+#include <limits>
+#include <map>
 #include <memory>
+#include <numeric>
 #include <set>
 #include <stack>
 #include <type_traits>
-
+#include <vector>
+
+#include "mesh.hh"
+#include "narrow_phase.hh"
+#include "parallel.hh"
+#include "pipeline.hh"
+#include "prepared_triangle.hh"
+#include "quantized_box.hh"
 #include "range3d.hh"
 #include "spdlog/spdlog.h"
 #include "triangle3d.hh"
+#include "triangle_batch.hh"
+#include "union_find.hh"
 
 namespace geometry {
 
+/**
+ * Every prepared triangle is stored once in one array sorted by nodes, nodes
+ * keep 32-bit positions in it. Partition moves positions only, so the tree is
+ * built without copies of prepared triangles.
+ */
 template <typename T>
 class Octree final {
-  // because we need to erase elements from middle
-  using InternalContainer = std::list<std::pair<Triangle3D<T>, std::size_t>>;
+  using Entry = std::pair<PreparedTriangle<T>, std::size_t>;
+  using InternalContainer = std::vector<Entry>;
+  using Positions = std::vector<std::uint32_t>;
+
+  /**
+   * Candidate visitor which calls f(i, j) for pairs that intersect.
+   */
+  template <typename F>
+  static auto narrowPhase(F& f, NarrowPhase kernel) noexcept {
+    return [&f, kernel](const Entry& a, const Entry& b) {
+      if (intersects(a.first, b.first, kernel)) {
+        SPDLOG_TRACE("Triangles {} and {} intersect", a.second, b.second);
+        f(a.second, b.second);
+      }
+    };
+  }
 
  private:
   /**
@@ -26,13 +60,17 @@ class Octree final {
    */
   struct Node final {
     Range3D<T> coords_;
-    InternalContainer triangles_;
+    Positions triangles_;           // own triangles in store_
+    const Entry* store_ = nullptr;  // triangles of the whole tree
+    TriangleBatch<T> batch_;        // same triangles as structure of arrays
+    BoxQuantizer<T> quantizer_;     // grid of node coords
+    QuantizedBoxes boxes_;          // grown ranges of own triangles
     std::array<std::unique_ptr<Node>, 8> children_;
     std::bitset<8> valid_children_;
 
     Node(const Range3D<T>& coords = {}) noexcept : coords_(coords) {}
 
-    void partition() {
+    void partition(const InternalContainer& store) {
       std::stack<Node*> node_stack;
       node_stack.push(this);
 
@@ -83,22 +121,26 @@ class Octree final {
         auto triangles_begin = current_triangles.begin();
         auto triangles_end = current_triangles.end();
 
-        current_triangles.remove_if([&current_node](auto& tr) {
-          auto moved = false;
-          auto range = tr.first.getRange();
-
-          for (auto i = 0; i < 8; ++i) {
-            auto&& ch = current_node->children_[i];
-            if (ch->coords_.contains(range)) {
-              SPDLOG_TRACE("Moving triangle {} to child {}", tr.second, i);
-
-              current_node->valid_children_[i] = true;
-              ch->triangles_.push_front(tr);
-              moved = true;
-            }
-          }
-          return moved;
-        });
+        auto moved_begin = std::remove_if(
+            triangles_begin, triangles_end, [&current_node, &store](auto pos) {
+              auto moved = false;
+              auto&& range = store[pos].first.range_;
+
+              for (auto i = 0; i < 8; ++i) {
+                auto&& ch = current_node->children_[i];
+                if (ch->coords_.contains(range)) {
+                  SPDLOG_TRACE("Moving triangle {} to child {}",
+                               store[pos].second, i);
+
+                  current_node->valid_children_[i] = true;
+                  ch->triangles_.push_back(pos);
+                  moved = true;
+                }
+              }
+              return moved;
+            });
+        current_triangles.erase(moved_begin, triangles_end);
+        current_triangles.shrink_to_fit();
 
         for (auto ch = 0; ch < 8; ++ch) {
           if (!current_node->children_[ch]->triangles_.empty()) {
@@ -111,81 +153,142 @@ class Octree final {
       }
     }
 
-    std::set<std::size_t> getIntersections() const {
-      std::stack<const Node*> node_stack;
-      node_stack.push(this);
-
-      std::set<std::size_t> res;
-
-      while (!node_stack.empty()) {
-        auto current_node = node_stack.top();
-        node_stack.pop();
+    void buildBatch(const Entry* store) {
+      store_ = store;
+      batch_.assign(triangles_.begin(), triangles_.end(),
+                    [store](auto pos) -> auto& {
+                      return store[pos].first.triangle_;
+                    });
+      quantizer_ = BoxQuantizer<T>(coords_);
+      boxes_.assign(triangles_.begin(), triangles_.end(),
+                    [this, store](auto pos) {
+                      auto&& t = store[pos].first;
+                      return quantizer_(t.range_, margin(t));
+                    });
+    }
 
-        auto triangles_begin = current_node->triangles_.begin();
-        auto triangles_end = current_node->triangles_.end();
-
-        for (auto it = triangles_begin; it != triangles_end; ++it) {
-          for (auto jt = it; jt != triangles_end; ++jt) {
-            if (it->second == jt->second) {
-              continue;
-            }
-            if (it->first.intersects(jt->first)) {
-              res.insert(it->second);
-              res.insert(jt->second);
-
-              SPDLOG_TRACE("Triangles {} and {} intersect", it->second,
-                           jt->second);
-            }
-          }
+    /**
+     * Kernels accept contact within tolerance, so ranges are grown by it
+     * before quantization. Each side is grown by its own band, the sum is
+     * not less than the band of the pair.
+     */
+    static T margin(const PreparedTriangle<T>& t) noexcept {
+      return comparator::kernelBand(t.scale_);
+    }
 
-          current_node->getIntersectionsAmongChildren(res, *it);
-        }
+    /**
+     * Calls g(triangle, other) for own triangles starting from begin which
+     * may intersect triangle. Pairs whose quantized boxes are apart are
+     * skipped. Kernels other than generic first run over the batch, so that
+     * only pairs which survive vectorized sign tests reach the scalar code.
+     * The batch rejects clearly separated pairs only, which is right for all
+     * of them.
+     */
+    template <typename G>
+    void forEachCandidateInNode(G& g, const Entry& triangle,
+                                std::size_t begin, NarrowPhase kernel) const {
+      auto candidate = [this, &g, &triangle](auto k) {
+        g(triangle, store_[triangles_[k]]);
+      };
+
+      auto box = quantizer_(triangle.first.range_, margin(triangle.first));
+      if (kernel != NarrowPhase::kGeneric) {
+        // registers of the batch are loaded only for overlapping boxes,
+        // both go in blocks of the same lanes
+        auto overlapping = [this, &box](std::size_t k, std::uint32_t valid) {
+          return boxes_.overlapping(box, k) & valid;
+        };
+        batch_.forEachCandidate(triangle.first, begin, candidate,
+                                overlapping);
+        return;
+      }
+      boxes_.forEachOverlapping(box, begin, candidate);
+    }
 
-        for (auto i = 0; i < 8; ++i) {
-          if (current_node->valid_children_[i]) {
-            node_stack.push(current_node->children_[i].get());
-          }
-        }
+    /**
+     * Calls g(a, b) for every candidate pair with at least one triangle
+     * stored in this node. Triangles of descendants may only intersect
+     * triangles of this node or of their own subtree, so together these calls
+     * over all nodes visit every pair. A triangle within tolerance of a split
+     * plane is copied into every child containing it, pairs of two copies
+     * are visited once per child holding both.
+     */
+    template <typename G>
+    void forEachCandidateFromNode(G& g, NarrowPhase kernel,
+                                  std::vector<const Node*>& stack) const {
+      for (auto it = triangles_.begin(); it != triangles_.end(); ++it) {
+        forEachCandidateOfTriangle(g, it, kernel, stack);
       }
-      return res;
     }
 
-    void getIntersectionsAmongChildren(
-        std::set<std::size_t>& res,
-        const std::pair<Triangle3D<T>, std::size_t>& triangle) const {
+    /**
+     * Pairs one triangle of this node with the triangles after it and with
+     * the whole subtree.
+     */
+    template <typename G>
+    void forEachCandidateOfTriangle(G& g,
+                                    typename Positions::const_iterator it,
+                                    NarrowPhase kernel,
+                                    std::vector<const Node*>& stack) const {
+      auto&& triangle = store_[*it];
+      forEachCandidateInNode(g, triangle, it - triangles_.begin() + 1,
+                             kernel);
+      forEachCandidateAmongChildren(g, triangle, kernel, stack);
+    }
+
+    /**
+     * Depth-first walk over the subtree. Stack is supplied by caller and
+     * reused between calls, it never holds more pointers than there are
+     * nodes in the tree.
+     */
+    template <typename G>
+    void forEachCandidateAmongChildren(
+        G& g, const Entry& triangle, NarrowPhase kernel,
+        std::vector<const Node*>& node_stack) const {
       if (valid_children_ == 0) {
         return;
       }
 
-      std::stack<const Node*> node_stack;
-      node_stack.push(this);
+      node_stack.clear();
+      node_stack.push_back(this);
 
       while (!node_stack.empty()) {
-        auto current_node = node_stack.top();
-        node_stack.pop();
+        auto current_node = node_stack.back();
+        node_stack.pop_back();
 
         for (auto ch = 0; ch < 8; ++ch) {
           if (current_node->valid_children_[ch]) {
-            auto&& current_triangles = current_node->children_[ch]->triangles_;
-            auto triangles_begin = current_triangles.begin();
-            auto triangles_end = current_triangles.end();
-
-            std::for_each(triangles_begin, triangles_end,
-                          [triangle, &res](const auto& other) {
-                            if (other.first.intersects(triangle.first)) {
-                              res.insert(other.second);
-                              res.insert(triangle.second);
-
-                              SPDLOG_TRACE("Triangles {} and {} intersect",
-                                           triangle.second, other.second);
-                            }
-                          });
-
-            node_stack.push(current_node->children_[ch].get());
+            auto&& child = current_node->children_[ch];
+            child->forEachCandidateInNode(g, triangle, 0, kernel);
+            node_stack.push_back(child.get());
           }
         }
       }
     }
+
+    /**
+     * Calls f(i, j) for every intersecting pair with at least one triangle
+     * stored in this node.
+     */
+    template <typename F>
+    void forEachIntersectionFromNode(F& f, NarrowPhase kernel,
+                                     std::vector<const Node*>& stack) const {
+      auto test = narrowPhase(f, kernel);
+      forEachCandidateFromNode(test, kernel, stack);
+    }
+
+    /**
+     * Tests one triangle of this node against the triangles after it and
+     * against the whole subtree.
+     */
+    template <typename F>
+    void forEachIntersectionOfTriangle(F& f,
+                                       typename Positions::const_iterator it,
+                                       NarrowPhase kernel,
+                                       std::vector<const Node*>& stack) const {
+      auto test = narrowPhase(f, kernel);
+      forEachCandidateOfTriangle(test, it, kernel, stack);
+    }
   };
 
  public:
@@ -195,6 +298,35 @@ class Octree final {
                 typename std::iterator_traits<It>::iterator_category>>>
   Octree(It begin, It end, std::size_t min_size = kMinSize)
       : root_(std::make_unique<Node>()) {
+    if constexpr (std::is_base_of_v<
+                      std::forward_iterator_tag,
+                      typename std::iterator_traits<It>::iterator_category>) {
+      store_.reserve(std::distance(begin, end));
+    }
+    for (; begin != end; ++begin) {
+      store_.emplace_back(PreparedTriangle<T>(*begin), store_.size());
+    }
+    build();
+  }
+
+  /**
+   * Mesh mode: triangles with common vertices intersect only if they meet
+   * beyond them, see intersectsAdjacent(). Every face is copied out of the
+   * vertex pool into its prepared triangle together with its vertex ids,
+   * kernels read the copies and the mesh is not needed after construction.
+   */
+  explicit Octree(const IndexedMesh<T>& mesh)
+      : root_(std::make_unique<Node>()) {
+    store_.reserve(mesh.size());
+    for (std::size_t i = 0; i < mesh.size(); ++i) {
+      store_.emplace_back(PreparedTriangle<T>(mesh[i]), i).first.vertices_ =
+          mesh.faces_[i];
+    }
+    build();
+  }
+
+ private:
+  void build() {
     constexpr auto kMinT = std::numeric_limits<T>::min();
     constexpr auto kMaxT = std::numeric_limits<T>::max();
 
@@ -204,9 +336,8 @@ class Octree final {
                      .max_y_ = kMinT,
                      .min_z_ = kMaxT,
                      .max_z_ = kMinT};
-    std::size_t count = 0;
-    for (; begin != end; ++count, ++begin) {
-      auto cur = begin->getRange();
+    for (auto&& tr : store_) {
+      auto&& cur = tr.first.range_;
 
       range.min_x_ = std::min(range.min_x_, cur.min_x_);
       range.max_x_ = std::max(range.max_x_, cur.max_x_);
@@ -214,24 +345,388 @@ class Octree final {
       range.max_y_ = std::max(range.max_y_, cur.max_y_);
       range.min_z_ = std::min(range.min_z_, cur.min_z_);
       range.max_z_ = std::max(range.max_z_, cur.max_z_);
-
-      root_->triangles_.emplace_front(*begin, count);
     }
 
-    cnt_ = count;
+    assignCoplanarGroups(store_.begin(), store_.end(),
+                         [](auto& tr) -> auto& { return tr.first; });
+
+    cnt_ = store_.size();
+    assert(cnt_ <= UINT32_MAX);
     root_->coords_ = range;
-    root_->partition();
+    root_->triangles_.resize(cnt_);
+    std::iota(root_->triangles_.begin(), root_->triangles_.end(), 0);
+    root_->partition(store_);
+
+    // breadth-first, nodes closer to root test against larger subtrees, so
+    // the order is already sorted by expected work well enough
+    std::vector<Node*> nodes{root_.get()};
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      for (auto ch = 0; ch < 8; ++ch) {
+        if (nodes[i]->valid_children_[ch]) {
+          nodes.push_back(nodes[i]->children_[ch].get());
+        }
+      }
+    }
+    sortByNodes(nodes);
+    for (auto node : nodes) {
+      node->buildBatch(store_.data());
+    }
+    nodes_.assign(nodes.begin(), nodes.end());
   }
 
-  std::set<std::size_t> getIntersections() const {
-    return root_->getIntersections();
+  /**
+   * Reorders store so that triangles of one node are adjacent, in the order
+   * of nodes. Triangles kept by two nodes go with the first one.
+   */
+  void sortByNodes(const std::vector<Node*>& nodes) {
+    constexpr auto kUnset = std::numeric_limits<std::uint32_t>::max();
+    Positions to(cnt_, kUnset);
+    std::uint32_t next = 0;
+    for (auto node : nodes) {
+      for (auto&& pos : node->triangles_) {
+        if (to[pos] == kUnset) {
+          to[pos] = next++;
+        }
+        pos = to[pos];
+      }
+    }
+    assert(next == cnt_);
+
+    // cycles of the permutation are closed by swaps, every swap puts one
+    // triangle to its place
+    for (std::size_t i = 0; i < cnt_; ++i) {
+      while (to[i] != i) {
+        std::swap(store_[i], store_[to[i]]);
+        std::swap(to[i], to[to[i]]);
+      }
+    }
   }
 
+ public:
+  /**
+   * Reusable buffers for queries: traversal stack for every thread and hit
+   * flags. They grow during the first query and are kept afterwards, so
+   * further single-threaded queries with the same scratch do not touch the
+   * heap. One scratch may serve several trees but only one query at a time.
+   */
+  class Scratch final {
+   private:
+    friend class Octree;
+
+    void reserve(unsigned threads, std::size_t nodes, std::size_t count) {
+      if (stacks_.size() < threads) {
+        stacks_.resize(threads);
+      }
+      for (auto&& stack : stacks_) {
+        stack.reserve(nodes);
+      }
+      if (hits_size_ < count) {
+        hits_ = std::make_unique<std::atomic<bool>[]>(count);
+        hits_size_ = count;
+      }
+    }
+
+   private:
+    std::vector<std::vector<const Node*>> stacks_;
+    std::unique_ptr<std::atomic<bool>[]> hits_;
+    std::size_t hits_size_ = 0;
+  };
+
+  /**
+   * Calls f(i, j) for every pair of intersecting triangles. Pairs of
+   * triangles copied into several children may come more than once, callers
+   * which need each pair once drop repeats. With more than one thread f is
+   * called concurrently and has to be thread safe. threads = 0 means all
+   * hardware threads.
+   */
+  template <typename F>
+  void forEachIntersectingPair(F f, unsigned threads = 1) const {
+    Scratch scratch;
+    forEachIntersectingPair(f, scratch, threads);
+  }
+
+  template <typename F>
+  void forEachIntersectingPair(F f, Scratch& scratch,
+                               unsigned threads = 1) const {
+    threads = resolveThreads(threads);
+    scratch.reserve(threads, nodes_.size(), cnt_);
+    parallelFor(nodes_.size(), threads, [this, &f, &scratch](auto i, auto t) {
+      nodes_[i]->forEachIntersectionFromNode(f, narrow_phase_,
+                                             scratch.stacks_[t]);
+    });
+  }
+
+  /**
+   * Same with broad and narrow phase apart, see runPipeline(). Broad threads
+   * walk the tree and emit candidate pairs as positions in the store,
+   * narrow threads test them. On trees where few nodes hold most of the
+   * pairs both stages stay busy, as the narrow work of a dense node is
+   * spread over all narrow threads.
+   */
+  template <typename F>
+  void forEachIntersectingPair(F f, const PipelineOptions& pipeline) const {
+    Scratch scratch;
+    scratch.reserve(resolveThreads(pipeline.broad_threads), nodes_.size(), 0);
+    auto store = store_.data();
+    auto produce = [this, &scratch, store](auto i, auto t, auto& emit) {
+      auto candidate = [store, &emit](const Entry& a, const Entry& b) {
+        emit(static_cast<std::uint64_t>(&a - store) << 32 |
+             static_cast<std::uint64_t>(&b - store));
+      };
+      nodes_[i]->forEachCandidateFromNode(candidate, narrow_phase_,
+                                          scratch.stacks_[t]);
+    };
+    auto consume = [this, &f, store](const std::uint64_t* begin,
+                                     const std::uint64_t* end) {
+      auto test = narrowPhase(f, narrow_phase_);
+      for (auto c = begin; c != end; ++c) {
+        test(store[*c >> 32], store[*c & UINT32_MAX]);
+      }
+    };
+    runPipeline(nodes_.size(), produce, consume, pipeline);
+  }
+
+  std::set<std::size_t> getIntersections(
+      const PipelineOptions& pipeline) const {
+    auto hits = std::make_unique<std::atomic<bool>[]>(cnt_);
+    forEachIntersectingPair(
+        [&hits](auto i, auto j) {
+          hits[i].store(true, std::memory_order_relaxed);
+          hits[j].store(true, std::memory_order_relaxed);
+        },
+        pipeline);
+
+    std::set<std::size_t> res;
+    for (std::size_t i = 0; i < cnt_; ++i) {
+      if (hits[i].load(std::memory_order_relaxed)) {
+        res.insert(res.end(), i);
+      }
+    }
+    return res;
+  }
+
+  std::set<std::size_t> getIntersections(unsigned threads = 1) const {
+    Scratch scratch;
+    std::vector<std::size_t> hits;
+    getIntersections(hits, scratch, threads);
+    return {hits.begin(), hits.end()};
+  }
+
+  /**
+   * Writes indices of intersecting triangles to res in ascending order.
+   * Allocates nothing when res and scratch already have enough capacity and
+   * the query is single-threaded, more threads cost their start only.
+   */
+  void getIntersections(std::vector<std::size_t>& res, Scratch& scratch,
+                        unsigned threads = 1) const {
+    scratch.reserve(resolveThreads(threads), nodes_.size(), cnt_);
+    auto&& hits = scratch.hits_;
+    for (std::size_t i = 0; i < cnt_; ++i) {
+      hits[i].store(false, std::memory_order_relaxed);
+    }
+
+    forEachIntersectingPair(
+        [&hits](auto i, auto j) {
+          hits[i].store(true, std::memory_order_relaxed);
+          hits[j].store(true, std::memory_order_relaxed);
+        },
+        scratch, threads);
+
+    res.clear();
+    for (std::size_t i = 0; i < cnt_; ++i) {
+      if (hits[i].load(std::memory_order_relaxed)) {
+        res.push_back(i);
+      }
+    }
+  }
+
+  /**
+   * Groups intersecting triangles into connected components of intersection
+   * graph. Pairs go to union-find right from the parallel traversal, the
+   * result is keyed by the smallest index of component.
+   */
+  std::map<std::size_t, std::vector<std::size_t>> getComponents(
+      unsigned threads = 1) const {
+    ConcurrentUnionFind uf(cnt_);
+    forEachIntersectingPair([&uf](auto i, auto j) { uf.unite(i, j); },
+                            threads);
+    return uf.components();
+  }
+
+  std::map<std::size_t, std::vector<std::size_t>> getComponents(
+      const PipelineOptions& pipeline) const {
+    ConcurrentUnionFind uf(cnt_);
+    forEachIntersectingPair([&uf](auto i, auto j) { uf.unite(i, j); },
+                            pipeline);
+    return uf.components();
+  }
+
+  /**
+   * Limits for one step of AnytimeQuery, whichever runs out first.
+   */
+  struct QueryBudget final {
+    std::chrono::steady_clock::duration time =
+        std::chrono::steady_clock::duration::max();
+    std::size_t work = std::numeric_limits<std::size_t>::max();  // pair tests
+  };
+
+  /**
+   * Deadline-bounded query which may be resumed. Nodes are processed from the
+   * densest one, where hits are most likely, and the object itself is the
+   * cursor: every run() continues right after the last tested triangle, so no
+   * pair is tested twice over the whole query. Octree must outlive it.
+   */
+  class AnytimeQuery final {
+    struct Task final {
+      const Node* node_;
+      std::size_t descendants_;  // triangles in subtree below node
+      std::size_t work_;         // pair tests made by node
+      double density_;
+    };
+
+   public:
+    explicit AnytimeQuery(const Octree<T>& tree)
+        : narrow_phase_(tree.narrow_phase_) {
+      stack_.reserve(tree.nodes_.size());
+      std::vector<const Node*> nodes{tree.root_.get()};
+      std::vector<std::size_t> parents{0};
+      for (std::size_t i = 0; i < nodes.size(); ++i) {
+        for (auto ch = 0; ch < 8; ++ch) {
+          if (nodes[i]->valid_children_[ch]) {
+            nodes.push_back(nodes[i]->children_[ch].get());
+            parents.push_back(i);
+          }
+        }
+      }
+
+      // triangles in subtree, children always go after parents
+      std::vector<std::size_t> subtree(nodes.size());
+      for (auto i = nodes.size(); i-- > 0;) {
+        subtree[i] += nodes[i]->triangles_.size();
+        if (i != 0) {
+          subtree[parents[i]] += subtree[i];
+        }
+      }
+
+      for (std::size_t i = 0; i < nodes.size(); ++i) {
+        auto own = nodes[i]->triangles_.size();
+        if (own == 0) {
+          continue;
+        }
+        auto&& c = nodes[i]->coords_;
+        auto volume = std::max<double>(c.dimX() * c.dimY() * c.dimZ(),
+                                       std::numeric_limits<double>::min());
+        auto descendants = subtree[i] - own;
+        auto work = own * (own - 1) / 2 + own * descendants;
+        tasks_.push_back({nodes[i], descendants, work, own / volume});
+        total_work_ += work;
+      }
+
+      std::stable_sort(tasks_.begin(), tasks_.end(),
+                       [](const auto& a, const auto& b) {
+                         return a.density_ > b.density_ ||
+                                (a.density_ == b.density_ && a.work_ > b.work_);
+                       });
+      resetPosition();
+    }
+
+    /**
+     * Continues the query until budget is spent. Returns true if the query
+     * is complete.
+     */
+    bool run(const QueryBudget& budget) {
+      auto start = std::chrono::steady_clock::now();
+      std::size_t spent = 0;
+      auto insert = [this](auto i, auto j) {
+        res_.insert(i);
+        res_.insert(j);
+      };
+
+      while (!complete()) {
+        if (spent >= budget.work ||
+            std::chrono::steady_clock::now() - start >= budget.time) {
+          return false;
+        }
+
+        auto&& task = tasks_[task_];
+        // one triangle is tested against the ones after it and subtree
+        auto own = task.node_->triangles_.size();
+        auto step = own - 1 - offset_ + task.descendants_;
+
+        task.node_->forEachIntersectionOfTriangle(insert, triangle_,
+                                                  narrow_phase_, stack_);
+        spent += step;
+        done_work_ += step;
+
+        ++offset_;
+        if (++triangle_ == task.node_->triangles_.end()) {
+          ++task_;
+          resetPosition();
+        }
+      }
+      return true;
+    }
+
+    const std::set<std::size_t>& getIntersections() const noexcept {
+      return res_;
+    }
+
+    bool complete() const noexcept { return task_ == tasks_.size(); }
+
+    /** share of pair tests already made */
+    double completeness() const noexcept {
+      return total_work_ == 0 ? 1.0
+                              : static_cast<double>(done_work_) / total_work_;
+    }
+
+   private:
+    void resetPosition() noexcept {
+      offset_ = 0;
+      if (!complete()) {
+        triangle_ = tasks_[task_].node_->triangles_.begin();
+      }
+    }
+
+   private:
+    std::vector<Task> tasks_;
+    std::size_t total_work_ = 0;
+    std::size_t done_work_ = 0;
+
+    // cursor
+    std::size_t task_ = 0;
+    typename Positions::const_iterator triangle_;
+    std::size_t offset_ = 0;
+
+    NarrowPhase narrow_phase_;
+    std::vector<const Node*> stack_;
+    std::set<std::size_t> res_;
+  };
+
+  AnytimeQuery startQuery() const { return AnytimeQuery(*this); }
+
   auto size() const noexcept { return cnt_; }
 
+  /**
+   * Prepared triangles of the tree by index, valid while the tree lives.
+   * Work on pairs after a query takes them instead of preparing again.
+   */
+  std::vector<const PreparedTriangle<T>*> preparedByIndex() const {
+    std::vector<const PreparedTriangle<T>*> res(cnt_);
+    for (auto&& [triangle, index] : store_) {
+      res[index] = &triangle;
+    }
+    return res;
+  }
+
+  NarrowPhase narrowPhase() const noexcept { return narrow_phase_; }
+  void setNarrowPhase(NarrowPhase kernel) noexcept { narrow_phase_ = kernel; }
+
  private:
+  InternalContainer store_;  // sorted by nodes, see sortByNodes()
   std::unique_ptr<Node> root_;
+  std::vector<const Node*> nodes_;  // breadth-first, for parallel traversal
   std::size_t cnt_;
+  NarrowPhase narrow_phase_ = kDefaultNarrowPhase;
 
  private:
   /** min number of triangles inside node */
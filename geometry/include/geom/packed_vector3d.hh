@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include "comparator.hh"
+#include "simd.hh"
+#include "vector3d.hh"
+
+namespace geometry {
+
+/**
+ * Vector3D kept in one aligned register of four lanes, the fourth one is
+ * padding. Operations mirror the free functions of Vector3D and give the
+ * same results, so code may switch between the two freely: load points with
+ * the converting constructor, compute in registers, unpack() the result.
+ * Double takes two registers of two lanes without AVX2, targets with no
+ * SSE2 or NEON use the scalar backend.
+ */
+template <typename T, typename B = simd::Xyz<T>>
+struct alignas(4 * sizeof(T)) PackedVector3D final {
+  static_assert(std::is_floating_point_v<T>);
+  using Backend = B;
+  using Reg = typename B::Reg;
+
+  Reg r_ = B::set(NAN, NAN, NAN);
+
+  PackedVector3D() noexcept = default;
+  explicit PackedVector3D(Reg r) noexcept : r_(r) {}
+  explicit PackedVector3D(const Vector3D<T>& v) noexcept
+      : r_(B::set(v.x_, v.y_, v.z_)) {}
+
+  T x() const noexcept { return B::get(r_, 0); }
+  T y() const noexcept { return B::get(r_, 1); }
+  T z() const noexcept { return B::get(r_, 2); }
+  Vector3D<T> unpack() const noexcept { return {x(), y(), z()}; }
+
+  bool valid() const noexcept {
+    return B::le3(B::abs(r_), B::set1(std::numeric_limits<T>::max()));
+  }
+  T norm2() const noexcept { return B::sum3(B::mul(r_, r_)); }
+  T norm() const noexcept { return std::sqrt(norm2()); }
+
+  /** comparator::isClose() in every coordinate */
+  bool isClose(const PackedVector3D& other) const noexcept {
+    auto diff = B::abs(B::sub(r_, other.r_));
+    auto largest = B::max(B::abs(r_), B::abs(other.r_));
+    auto tol = B::max(B::mul(B::set1(comparator::kRelTol<T>), largest),
+                      B::set1(comparator::kAbsTol<T>));
+    return B::le3(diff, tol);
+  }
+
+  PackedVector3D& operator+=(const PackedVector3D& rhs) noexcept {
+    r_ = B::add(r_, rhs.r_);
+    return *this;
+  }
+
+  PackedVector3D& operator-=(const PackedVector3D& rhs) noexcept {
+    r_ = B::sub(r_, rhs.r_);
+    return *this;
+  }
+
+  PackedVector3D& operator*=(T scalar) noexcept {
+    r_ = B::mul(r_, B::set1(scalar));
+    return *this;
+  }
+
+  PackedVector3D& operator/=(T scalar) noexcept {
+    r_ = B::div(r_, B::set1(scalar));
+    return *this;
+  }
+
+  PackedVector3D operator-() const noexcept {
+    return PackedVector3D(*this) *= static_cast<T>(-1);
+  }
+
+  PackedVector3D& normalize() noexcept { return *this /= norm(); }
+
+  static PackedVector3D nullVector() noexcept {
+    return PackedVector3D(B::set(0, 0, 0));
+  }
+};
+
+template <typename T, typename B>
+PackedVector3D<T, B> operator+(const PackedVector3D<T, B>& a,
+                               const PackedVector3D<T, B>& b) noexcept {
+  return PackedVector3D<T, B>(a) += b;
+}
+
+template <typename T, typename B>
+PackedVector3D<T, B> operator-(const PackedVector3D<T, B>& a,
+                               const PackedVector3D<T, B>& b) noexcept {
+  return PackedVector3D<T, B>(a) -= b;
+}
+
+template <typename T, typename B>
+PackedVector3D<T, B> operator*(T scalar,
+                               const PackedVector3D<T, B>& v) noexcept {
+  return PackedVector3D<T, B>(v) *= scalar;
+}
+
+template <typename T, typename B>
+PackedVector3D<T, B> operator*(const PackedVector3D<T, B>& v,
+                               T scalar) noexcept {
+  return PackedVector3D<T, B>(v) *= scalar;
+}
+
+template <typename T, typename B>
+PackedVector3D<T, B> operator/(const PackedVector3D<T, B>& v,
+                               T scalar) noexcept {
+  return PackedVector3D<T, B>(v) /= scalar;
+}
+
+template <typename T, typename B>
+T dot(const PackedVector3D<T, B>& a, const PackedVector3D<T, B>& b) noexcept {
+  return B::sum3(B::mul(a.r_, b.r_));
+}
+
+template <typename T, typename B>
+PackedVector3D<T, B> crossProduct(const PackedVector3D<T, B>& a,
+                                  const PackedVector3D<T, B>& b) noexcept {
+  auto left = B::mul(B::yzx(a.r_), B::zxy(b.r_));
+  auto right = B::mul(B::zxy(a.r_), B::yzx(b.r_));
+  return PackedVector3D<T, B>(B::sub(left, right));
+}
+
+template <typename T, typename B>
+T tripleProduct(const PackedVector3D<T, B>& a, const PackedVector3D<T, B>& b,
+                const PackedVector3D<T, B>& c) noexcept {
+  return dot(a, crossProduct(b, c));
+}
+
+template <typename T, typename B>
+bool collinear(const PackedVector3D<T, B>& a,
+               const PackedVector3D<T, B>& b) noexcept {
+  return crossProduct(a, b).isClose(PackedVector3D<T, B>::nullVector());
+}
+
+}  // namespace geometry
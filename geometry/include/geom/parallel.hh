@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace geometry {
+
+/**
+ * Returns number of worker threads to use, 0 means all hardware threads.
+ */
+inline unsigned resolveThreads(unsigned threads) noexcept {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  return std::max(threads, 1u);
+}
+
+/**
+ * Calls f(i, thread_id) for every i in [0, count) on given number of threads.
+ * Items are handed out one by one from shared counter, so uneven items
+ * balance between threads.
+ */
+template <typename F>
+void parallelFor(std::size_t count, unsigned threads, F&& f) {
+  threads = std::min<std::size_t>(resolveThreads(threads), count);
+  if (threads <= 1) {
+    for (std::size_t i = 0; i < count; ++i) {
+      f(i, 0u);
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> next{0};
+  auto worker = [&next, &f, count](unsigned thread_id) {
+    for (auto i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+         i = next.fetch_add(1, std::memory_order_relaxed)) {
+      f(i, thread_id);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (unsigned t = 1; t < threads; ++t) {
+    pool.emplace_back(worker, t);
+  }
+  worker(0);
+  for (auto&& th : pool) {
+    th.join();
+  }
+}
+
+}  // namespace geometry
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hh"
+#include "parallel.hh"
+
+namespace geometry {
+
+/**
+ * Shape of the broad and narrow phase pipeline, see runPipeline().
+ * Thread counts of 0 mean all hardware threads.
+ */
+struct PipelineOptions final {
+  unsigned broad_threads = 1;
+  unsigned narrow_threads = 1;
+  std::size_t batch_size = 1024;  // candidates in one batch
+  std::size_t queue_depth = 64;   // batches waiting for narrow phase
+};
+
+/**
+ * Runs two stages on their own threads. Broad phase calls
+ * produce(i, thread_id, emit) for every i in [0, count) on broad threads,
+ * emit(c) adds a 64-bit candidate to the batch of the thread. Full batches
+ * go through a lock-free queue to narrow threads, which sort them and call
+ * consume(begin, end). Batches come from a fixed pool, so a broad phase
+ * ahead of the narrow one waits for a spare batch instead of growing memory.
+ */
+template <typename Produce, typename Consume>
+void runPipeline(std::size_t count, Produce&& produce, Consume&& consume,
+                 const PipelineOptions& opts) {
+  assert(opts.batch_size != 0 && opts.queue_depth != 0);
+  auto broad_threads = resolveThreads(opts.broad_threads);
+  auto narrow_threads = resolveThreads(opts.narrow_threads);
+
+  // every broad thread fills one batch, so queue_depth more keep the narrow
+  // phase supplied, spare and ready queues never overflow
+  auto pool = broad_threads + opts.queue_depth;
+  assert(pool <= UINT32_MAX);
+  std::vector<std::vector<std::uint64_t>> batches(pool);
+  BoundedQueue<std::uint32_t> spare(pool), ready(pool);
+  std::vector<std::uint32_t> current(broad_threads);
+  for (std::uint32_t b = 0; b < pool; ++b) {
+    batches[b].reserve(opts.batch_size);
+    if (b < broad_threads) {
+      current[b] = b;
+    } else {
+      spare.tryPush(b);
+    }
+  }
+
+  std::atomic<bool> broad_done{false};
+  auto narrow = [&batches, &spare, &ready, &broad_done, &consume] {
+    auto process = [&](std::uint32_t b) {
+      auto&& batch = batches[b];
+      // pairs of one triangle go together and the triangle stays in cache
+      std::sort(batch.begin(), batch.end());
+      consume(batch.data(), batch.data() + batch.size());
+      batch.clear();
+      spare.tryPush(b);
+    };
+    for (std::uint32_t b;;) {
+      if (ready.tryPop(b)) {
+        process(b);
+      } else if (broad_done.load(std::memory_order_acquire)) {
+        // pushes made before the flag are visible now
+        while (ready.tryPop(b)) {
+          process(b);
+        }
+        return;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  };
+
+  std::vector<std::thread> pool_threads;
+  pool_threads.reserve(narrow_threads);
+  for (unsigned t = 0; t < narrow_threads; ++t) {
+    pool_threads.emplace_back(narrow);
+  }
+
+  auto publish = [&ready](std::uint32_t b) {
+    while (!ready.tryPush(b)) {
+      std::this_thread::yield();
+    }
+  };
+  parallelFor(count, broad_threads, [&](std::size_t i, unsigned t) {
+    auto emit = [&, t](std::uint64_t c) {
+      auto&& batch = batches[current[t]];
+      batch.push_back(c);
+      if (batch.size() == opts.batch_size) {
+        publish(current[t]);
+        while (!spare.tryPop(current[t])) {
+          std::this_thread::yield();
+        }
+      }
+    };
+    produce(i, t, emit);
+  });
+  for (auto b : current) {
+    if (!batches[b].empty()) {
+      publish(b);
+    }
+  }
+  broad_done.store(true, std::memory_order_release);
+
+  for (auto&& th : pool_threads) {
+    th.join();
+  }
+}
+
+}  // namespace geometry
@@ -3,6 +3,7 @@
 #include <cassert>
 
 #include "line3d.hh"
+#include "packed_vector3d.hh"
 #include "segment3d.hh"
 #include "vector3d.hh"
 
@@ -18,10 +19,17 @@ class Plane final {
   Plane() noexcept {}
   Plane(const Vector3D<T>& a, const Vector3D<T>& b,
         const Vector3D<T>& c) noexcept
-      : n_(crossProduct(a - b, a - c).normalize()),
-        // normalization applied here to make easier comparison between planes
-        // and make plane with zero normal vector invalid in place
-        d_(dot(n_, a)) {}
+      : Plane(PackedVector3D<T>(a), PackedVector3D<T>(b),
+              PackedVector3D<T>(c)) {}
+
+  Plane(const PackedVector3D<T>& a, const PackedVector3D<T>& b,
+        const PackedVector3D<T>& c) noexcept {
+    // normalization applied here to make easier comparison between planes
+    // and make plane with zero normal vector invalid in place
+    auto n = crossProduct(a - b, a - c).normalize();
+    n_ = n.unpack();
+    d_ = dot(n, a);
+  }
 
   // getters
  public:
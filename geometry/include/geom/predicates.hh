@@ -0,0 +1,299 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "vector3d.hh"
+
+namespace geometry {
+
+/**
+ * Adaptive precision orientation predicates in the spirit of Shewchuk's
+ * "Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric
+ * Predicates". The determinant is evaluated in the storage type first, its
+ * sign is returned when it exceeds a rigorous bound of the rounding error,
+ * otherwise it is recomputed exactly with double expansions. Answers are
+ * exact for any float or double input without overflow and underflow.
+ * Integer coordinates are handled in 128-bit integer arithmetic.
+ */
+namespace predicates {
+
+template <typename T>
+using Point2D = std::array<T, 2>;
+
+namespace detail {
+
+/*
+ * Error free transformations, x is the rounded result and y its error.
+ */
+inline void twoSum(double a, double b, double& x, double& y) noexcept {
+  x = a + b;
+  auto bv = x - a;
+  auto av = x - bv;
+  y = (a - av) + (b - bv);
+}
+
+inline void fastTwoSum(double a, double b, double& x, double& y) noexcept {
+  x = a + b;  // |a| >= |b|
+  y = b - (x - a);
+}
+
+inline void twoDiff(double a, double b, double& x, double& y) noexcept {
+  x = a - b;
+  auto bv = a - x;
+  auto av = x + bv;
+  y = (a - av) + (bv - b);
+}
+
+inline void twoProduct(double a, double b, double& x, double& y) noexcept {
+  x = a * b;
+  y = std::fma(a, b, -x);
+}
+
+/**
+ * Sum of nonoverlapping components ordered by increasing magnitude, with
+ * zero components eliminated. Capacity is known at compile time, so exact
+ * evaluation never allocates.
+ */
+template <std::size_t N>
+struct Expansion final {
+  double e_[N];
+  std::size_t size_ = 0;
+
+  void push(double v) noexcept {
+    if (v != 0) {
+      e_[size_++] = v;
+    }
+  }
+
+  int sign() const noexcept {
+    return size_ == 0 ? 0 : e_[size_ - 1] > 0 ? 1 : -1;
+  }
+};
+
+inline Expansion<2> difference(double a, double b) noexcept {
+  Expansion<2> res;
+  double x, y;
+  twoDiff(a, b, x, y);
+  res.push(y);
+  res.push(x);
+  return res;
+}
+
+template <std::size_t N>
+Expansion<N> negate(Expansion<N> e) noexcept {
+  for (std::size_t i = 0; i < e.size_; ++i) {
+    e.e_[i] = -e.e_[i];
+  }
+  return e;
+}
+
+/** e * b, Shewchuk's scale_expansion_zeroelim */
+template <std::size_t N>
+Expansion<2 * N> scale(const Expansion<N>& e, double b) noexcept {
+  Expansion<2 * N> res;
+  if (e.size_ == 0) {
+    return res;
+  }
+  double q, h;
+  twoProduct(e.e_[0], b, q, h);
+  res.push(h);
+  for (std::size_t i = 1; i < e.size_; ++i) {
+    double p1, p0, s;
+    twoProduct(e.e_[i], b, p1, p0);
+    twoSum(q, p0, s, h);
+    res.push(h);
+    fastTwoSum(p1, s, q, h);
+    res.push(h);
+  }
+  res.push(q);
+  return res;
+}
+
+/**
+ * e + f, f grown into e one component at a time. R is the capacity of the
+ * result, it may be less than N + M when sizes are known to be smaller.
+ */
+template <std::size_t N, std::size_t M, std::size_t R = N + M>
+Expansion<R> sum(const Expansion<N>& e, const Expansion<M>& f) noexcept {
+  Expansion<R> res;
+  for (std::size_t i = 0; i < e.size_; ++i) {
+    res.e_[i] = e.e_[i];
+  }
+  res.size_ = e.size_;
+
+  for (std::size_t j = 0; j < f.size_; ++j) {
+    Expansion<R> grown;
+    auto q = f.e_[j];
+    for (std::size_t i = 0; i < res.size_; ++i) {
+      double h;
+      twoSum(q, res.e_[i], q, h);
+      grown.push(h);
+    }
+    grown.push(q);
+    res = grown;
+  }
+  return res;
+}
+
+template <std::size_t N, std::size_t M>
+Expansion<2 * N * M> product(const Expansion<N>& e,
+                             const Expansion<M>& f) noexcept {
+  Expansion<2 * N * M> res;
+  for (std::size_t j = 0; j < f.size_; ++j) {
+    // j + 1 partial products have at most 2 * N * (j + 1) components
+    res = sum<2 * N * M, 2 * N, 2 * N * M>(res, scale(e, f.e_[j]));
+  }
+  return res;
+}
+
+/** ax * by - ay * bx of exact differences */
+inline Expansion<16> cross2(const Expansion<2>& ax, const Expansion<2>& ay,
+                            const Expansion<2>& bx,
+                            const Expansion<2>& by) noexcept {
+  return sum(product(ax, by), negate(product(ay, bx)));
+}
+
+/** half of unit roundoff, Shewchuk's epsilon */
+template <typename T>
+inline constexpr T kHalfEps = std::numeric_limits<T>::epsilon() / 2;
+
+template <typename T>
+inline constexpr T kOrient2dBound = (3 + 16 * kHalfEps<T>) * kHalfEps<T>;
+
+template <typename T>
+inline constexpr T kOrient3dBound = (7 + 56 * kHalfEps<T>) * kHalfEps<T>;
+
+template <typename T>
+int sign(T v) noexcept {
+  return (v > 0) - (v < 0);
+}
+
+template <typename T>
+int orient2dExact(const Point2D<T>& a, const Point2D<T>& b,
+                  const Point2D<T>& c) noexcept {
+  auto acx = difference(a[0], c[0]), acy = difference(a[1], c[1]);
+  auto bcx = difference(b[0], c[0]), bcy = difference(b[1], c[1]);
+  return cross2(acx, acy, bcx, bcy).sign();
+}
+
+template <typename T>
+int orient3dExact(const Vector3D<T>& a, const Vector3D<T>& b,
+                  const Vector3D<T>& c, const Vector3D<T>& d) noexcept {
+  auto adx = difference(a.x_, d.x_), ady = difference(a.y_, d.y_),
+       adz = difference(a.z_, d.z_);
+  auto bdx = difference(b.x_, d.x_), bdy = difference(b.y_, d.y_),
+       bdz = difference(b.z_, d.z_);
+  auto cdx = difference(c.x_, d.x_), cdy = difference(c.y_, d.y_),
+       cdz = difference(c.z_, d.z_);
+
+  // cofactor expansion along the first row
+  auto x = product(adx, cross2(bdy, bdz, cdy, cdz));
+  auto y = product(ady, cross2(bdz, bdx, cdz, cdx));
+  auto z = product(adz, cross2(bdx, bdy, cdx, cdy));
+  return sum(sum(x, y), z).sign();
+}
+
+}  // namespace detail
+
+/**
+ * Sign of (a - c) x (b - c): positive if a, b, c go counterclockwise, zero
+ * if they are collinear.
+ */
+template <typename T>
+int orient2d(const Point2D<T>& a, const Point2D<T>& b,
+             const Point2D<T>& c) noexcept {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>);
+  auto left = (a[0] - c[0]) * (b[1] - c[1]);
+  auto right = (a[1] - c[1]) * (b[0] - c[0]);
+  auto det = left - right;
+  auto bound = detail::kOrient2dBound<T> * (std::abs(left) + std::abs(right));
+  if (det > bound || -det > bound) {
+    return detail::sign(det);
+  }
+  return detail::orient2dExact(a, b, c);
+}
+
+/**
+ * Sign of the determinant of rows a - d, b - d, c - d: positive if d lies
+ * below the plane through a, b, c, where "below" is defined so that a, b, c
+ * appear counterclockwise seen from above, zero if the points are
+ * coplanar.
+ */
+template <typename T>
+int orient3d(const Vector3D<T>& a, const Vector3D<T>& b, const Vector3D<T>& c,
+             const Vector3D<T>& d) noexcept {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>);
+  auto ad = a - d, bd = b - d, cd = c - d;
+
+  auto bdxcdy = bd.x_ * cd.y_, cdxbdy = cd.x_ * bd.y_;
+  auto cdxady = cd.x_ * ad.y_, adxcdy = ad.x_ * cd.y_;
+  auto adxbdy = ad.x_ * bd.y_, bdxady = bd.x_ * ad.y_;
+  auto det = ad.z_ * (bdxcdy - cdxbdy) + bd.z_ * (cdxady - adxcdy) +
+             cd.z_ * (adxbdy - bdxady);
+  auto permanent = (std::abs(bdxcdy) + std::abs(cdxbdy)) * std::abs(ad.z_) +
+                   (std::abs(cdxady) + std::abs(adxcdy)) * std::abs(bd.z_) +
+                   (std::abs(adxbdy) + std::abs(bdxady)) * std::abs(cd.z_);
+  auto bound = detail::kOrient3dBound<T> * permanent;
+  if (det > bound || -det > bound) {
+    return detail::sign(det);
+  }
+  return detail::orient3dExact(a, b, c, d);
+}
+
+/*
+ * Integer coordinates need no filter: differences take 33 bits, 2x2 minors
+ * 67 bits and the 3x3 determinant 101 bits, so 128-bit integers are exact.
+ */
+inline int orient2d(const Point2D<std::int32_t>& a,
+                    const Point2D<std::int32_t>& b,
+                    const Point2D<std::int32_t>& c) noexcept {
+  using Wide = __int128;
+  std::int64_t acx = a[0] - std::int64_t{c[0]}, acy = a[1] - std::int64_t{c[1]};
+  std::int64_t bcx = b[0] - std::int64_t{c[0]}, bcy = b[1] - std::int64_t{c[1]};
+  return detail::sign(Wide{acx} * bcy - Wide{acy} * bcx);
+}
+
+inline int orient3d(const Vector3D<std::int32_t>& a,
+                    const Vector3D<std::int32_t>& b,
+                    const Vector3D<std::int32_t>& c,
+                    const Vector3D<std::int32_t>& d) noexcept {
+  using Wide = __int128;
+  auto diff = [&d](const Vector3D<std::int32_t>& p) {
+    return std::array<Wide, 3>{Wide{p.x_} - d.x_, Wide{p.y_} - d.y_,
+                               Wide{p.z_} - d.z_};
+  };
+  auto ad = diff(a), bd = diff(b), cd = diff(c);
+  auto det = ad[2] * (bd[0] * cd[1] - cd[0] * bd[1]) +
+             bd[2] * (cd[0] * ad[1] - ad[0] * cd[1]) +
+             cd[2] * (ad[0] * bd[1] - bd[0] * ad[1]);
+  return detail::sign(det);
+}
+
+template <typename T>
+bool coplanar(const Vector3D<T>& a, const Vector3D<T>& b, const Vector3D<T>& c,
+              const Vector3D<T>& d) noexcept {
+  return orient3d(a, b, c, d) == 0;
+}
+
+/**
+ * Whether a, b, c lie on one line, checked in all three coordinate planes.
+ */
+template <typename T>
+bool collinear(const Vector3D<T>& a, const Vector3D<T>& b,
+               const Vector3D<T>& c) noexcept {
+  auto yz = [](const Vector3D<T>& p) { return Point2D<T>{p.y_, p.z_}; };
+  auto zx = [](const Vector3D<T>& p) { return Point2D<T>{p.z_, p.x_}; };
+  auto xy = [](const Vector3D<T>& p) { return Point2D<T>{p.x_, p.y_}; };
+  return orient2d(yz(a), yz(b), yz(c)) == 0 &&
+         orient2d(zx(a), zx(b), zx(c)) == 0 &&
+         orient2d(xy(a), xy(b), xy(c)) == 0;
+}
+
+}  // namespace predicates
+
+}  // namespace geometry
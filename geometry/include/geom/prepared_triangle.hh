@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "mesh.hh"
+#include "plane.hh"
+#include "predicates.hh"
+#include "range3d.hh"
+#include "segment3d.hh"
+#include "triangle3d.hh"
+
+namespace geometry {
+
+enum class Degeneracy : std::uint8_t {
+  kNone,     // proper triangle with a plane
+  kSegment,  // vertices on one line
+  kPoint,    // vertices coincide, segment has no direction
+};
+
+/**
+ * Triangle with everything narrow and broad phases derive from it computed
+ * once. The same triangle takes part in many pair tests, so the plane with
+ * its square root, the bounding box and the degeneracy checks are paid for
+ * only when the triangle is loaded.
+ */
+template <typename T>
+struct PreparedTriangle final {
+  Triangle3D<T> triangle_;
+  Plane<T> plane_;          // normalized, invalid for degenerate triangles
+  Vector3D<T> raw_normal_;  // (b - a) x (c - a), not normalized
+  T raw_normal_err_;        // >= |b - a| * |c - a|, bounds rounding of it
+  Range3D<T> range_;
+  T scale_;  // max absolute coordinate
+  Degeneracy degeneracy_;
+  std::uint8_t dominant_axis_;  // largest normal component, for 2D projection
+  // equal ids mean exactly one plane, see assignCoplanarGroups()
+  std::uint32_t coplanar_group_ = kNoGroup;
+  // ids of mesh mode, kNoVertex outside of it
+  VertexIds vertices_ = {kNoVertex, kNoVertex, kNoVertex};
+
+  static constexpr auto kNoGroup = std::numeric_limits<std::uint32_t>::max();
+
+  PreparedTriangle() = default;
+
+  explicit PreparedTriangle(const Triangle3D<T>& t) noexcept
+      : triangle_(t),
+        plane_(t.getPlane()),
+        raw_normal_(crossProduct(t.b_ - t.a_, t.c_ - t.a_)),
+        raw_normal_err_(((t.b_ - t.a_).norm2() + (t.a_ - t.c_).norm2()) / 2),
+        range_(t.getRange()),
+        scale_(std::max({std::abs(range_.min_x_), std::abs(range_.max_x_),
+                         std::abs(range_.min_y_), std::abs(range_.max_y_),
+                         std::abs(range_.min_z_), std::abs(range_.max_z_)})),
+        degeneracy_(plane_.valid() ? Degeneracy::kNone : Degeneracy::kSegment),
+        dominant_axis_(dominantAxis(raw_normal_)) {
+    if (degeneracy_ != Degeneracy::kNone && !segment().line().valid()) {
+      degeneracy_ = Degeneracy::kPoint;
+    }
+  }
+
+  /**
+   * Segment of degenerate triangles. It is rebuilt on every call rather than
+   * stored: only pairs with degenerate triangles need it, and a big scene
+   * keeps millions of prepared triangles.
+   */
+  Segment3D<T> segment() const noexcept { return triangle_.toSegment3D(); }
+
+  bool coplanarWith(const PreparedTriangle& other) const noexcept {
+    return coplanar_group_ != kNoGroup &&
+           coplanar_group_ == other.coplanar_group_;
+  }
+
+ private:
+
+  static std::uint8_t dominantAxis(const Vector3D<T>& n) noexcept {
+    auto x = std::abs(n.x_), y = std::abs(n.y_), z = std::abs(n.z_);
+    return x >= y && x >= z ? 0 : y >= z ? 1 : 2;
+  }
+};
+
+/**
+ * Gives exactly coplanar proper triangles of the range one coplanar group
+ * id, proj maps elements to prepared triangles. Planes are bucketed by
+ * rounded normal and distance, a triangle joins the first group of its
+ * bucket whose representative it is coplanar with by orient3d. Equal ids
+ * guarantee one plane, different ids do not rule it out: rounding may put
+ * one plane into two buckets.
+ */
+template <typename It, typename Proj>
+void assignCoplanarGroups(It begin, It end, Proj proj) {
+  using Prepared = std::remove_reference_t<decltype(proj(*begin))>;
+  // representatives compared within a bucket, the rest starts new groups
+  constexpr std::size_t kMaxRepresentatives = 8;
+  // larger distances do not fit rounded keys
+  constexpr auto kMaxDistance = 1e15;
+
+  struct Entry final {
+    std::array<long long, 4> key;
+    Prepared* triangle;
+  };
+  std::vector<Entry> entries;
+  for (; begin != end; ++begin) {
+    auto&& t = proj(*begin);
+    t.coplanar_group_ = Prepared::kNoGroup;
+    auto&& n = t.plane_.normal();
+    auto d = t.plane_.distance();
+    if (t.degeneracy_ != Degeneracy::kNone || !(std::abs(d) < kMaxDistance)) {
+      continue;
+    }
+    // one of two opposite normals, by sign of the dominant component
+    auto&& r = t.raw_normal_;
+    auto k = t.dominant_axis_;
+    auto s = (k == 0 ? r.x_ : k == 1 ? r.y_ : r.z_) < 0 ? -1.0 : 1.0;
+    entries.push_back(
+        {{std::llround(s * n.x_ * 1024), std::llround(s * n.y_ * 1024),
+          std::llround(s * n.z_ * 1024), std::llround(s * d * 64)},
+         &t});
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](auto&& l, auto&& r) { return l.key < r.key; });
+
+  std::uint32_t next = 0;
+  std::vector<const Prepared*> representatives;
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    if (i == 0 || entries[i].key != entries[i - 1].key) {
+      representatives.clear();
+    }
+    auto&& t = *entries[i].triangle;
+    auto&& v = t.triangle_;
+    auto same = std::find_if(
+        representatives.begin(), representatives.end(), [&v](auto rep) {
+          auto&& r = rep->triangle_;
+          return predicates::coplanar(r.a_, r.b_, r.c_, v.a_) &&
+                 predicates::coplanar(r.a_, r.b_, r.c_, v.b_) &&
+                 predicates::coplanar(r.a_, r.b_, r.c_, v.c_);
+        });
+    if (same != representatives.end()) {
+      t.coplanar_group_ = (*same)->coplanar_group_;
+      continue;
+    }
+    t.coplanar_group_ = next++;
+    if (representatives.size() < kMaxRepresentatives) {
+      representatives.push_back(&t);
+    }
+  }
+}
+
+}  // namespace geometry
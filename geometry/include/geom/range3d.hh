@@ -30,6 +30,15 @@ struct Range3D final {
            comparator::isLessClose(other.max_z_, max_z_);
   }
 
+  bool overlaps(const Range3D<T>& other) const noexcept {
+    return comparator::isLessClose(min_x_, other.max_x_) &&
+           comparator::isLessClose(other.min_x_, max_x_) &&
+           comparator::isLessClose(min_y_, other.max_y_) &&
+           comparator::isLessClose(other.min_y_, max_y_) &&
+           comparator::isLessClose(min_z_, other.max_z_) &&
+           comparator::isLessClose(other.min_z_, max_z_);
+  }
+
   T dimX() const noexcept { return max_x_ - min_x_; }
   T dimY() const noexcept { return max_y_ - min_y_; }
   T dimZ() const noexcept { return max_z_ - min_z_; }
@@ -10,7 +10,10 @@ struct Segment3D final {
   Vector3D<T> begin_;
   Vector3D<T> end_;
 
-  Line3D<T> line() const noexcept { return Line3D<T>(end_ - begin_, begin_); }
+  Line3D<T> line() const noexcept {
+    return Line3D<T>(PackedVector3D<T>(end_) - PackedVector3D<T>(begin_),
+                     begin_);
+  }
   Vector3D<T> getIntersectionPoint(const Line3D<T>& l) const noexcept {
     auto this_line = line();
     if (!this_line.valid()) {
@@ -0,0 +1,586 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * Code between GEOMETRY_TARGET_BEGIN(isa) and GEOMETRY_TARGET_END() may use
+ * instructions of isa whatever the target of the translation unit is, so
+ * one binary carries kernels for several instruction sets. Callers check
+ * the CPU first, see dispatch.hh. GCC and Clang on x86 only, elsewhere the
+ * macros are empty and only the target of the translation unit is used.
+ */
+#if defined(__GNUC__) && defined(__SSE2__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define GEOMETRY_SIMD_DISPATCH 1
+#define GEOMETRY_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define GEOMETRY_TARGET_BEGIN(isa)                                         \
+  GEOMETRY_PRAGMA(clang attribute push(__attribute__((target(isa))),     \
+                                       apply_to = function))
+#define GEOMETRY_TARGET_END() _Pragma("clang attribute pop")
+#else
+#define GEOMETRY_TARGET_BEGIN(isa) \
+  _Pragma("GCC push_options") GEOMETRY_PRAGMA(GCC target(isa))
+#define GEOMETRY_TARGET_END() _Pragma("GCC pop_options")
+#endif
+#else
+#define GEOMETRY_TARGET_BEGIN(isa)
+#define GEOMETRY_TARGET_END()
+#endif
+
+namespace geometry {
+
+namespace simd {
+
+/**
+ * Thin wrappers over vector registers, one per instruction set and scalar
+ * type. Kernels are written once against this interface:
+ * load/set1/add/sub/mul/max/abs give registers, gt/lt give bitmask of lanes.
+ */
+using Mask = std::uint32_t;
+
+/** one lane fallback for any scalar type and target */
+template <typename T>
+struct Scalar final {
+  using Value = T;
+  using Reg = T;
+  static constexpr unsigned kWidth = 1;
+
+  static Reg load(const T* p) noexcept { return *p; }
+  static Reg set1(T v) noexcept { return v; }
+  static Reg add(Reg a, Reg b) noexcept { return a + b; }
+  static Reg sub(Reg a, Reg b) noexcept { return a - b; }
+  static Reg mul(Reg a, Reg b) noexcept { return a * b; }
+  static Reg max(Reg a, Reg b) noexcept { return a > b ? a : b; }
+  static Reg abs(Reg a) noexcept { return std::abs(a); }
+  static Mask gt(Reg a, Reg b) noexcept { return a > b; }
+  static Mask lt(Reg a, Reg b) noexcept { return a < b; }
+};
+
+#if defined(__SSE2__)
+struct SseFloat final {
+  using Value = float;
+  using Reg = __m128;
+  static constexpr unsigned kWidth = 4;
+
+  static Reg load(const float* p) noexcept { return _mm_loadu_ps(p); }
+  static Reg set1(float v) noexcept { return _mm_set1_ps(v); }
+  static Reg add(Reg a, Reg b) noexcept { return _mm_add_ps(a, b); }
+  static Reg sub(Reg a, Reg b) noexcept { return _mm_sub_ps(a, b); }
+  static Reg mul(Reg a, Reg b) noexcept { return _mm_mul_ps(a, b); }
+  static Reg max(Reg a, Reg b) noexcept { return _mm_max_ps(a, b); }
+  static Reg abs(Reg a) noexcept {
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), a);
+  }
+  static Mask gt(Reg a, Reg b) noexcept {
+    return _mm_movemask_ps(_mm_cmpgt_ps(a, b));
+  }
+  static Mask lt(Reg a, Reg b) noexcept {
+    return _mm_movemask_ps(_mm_cmplt_ps(a, b));
+  }
+};
+
+struct SseDouble final {
+  using Value = double;
+  using Reg = __m128d;
+  static constexpr unsigned kWidth = 2;
+
+  static Reg load(const double* p) noexcept { return _mm_loadu_pd(p); }
+  static Reg set1(double v) noexcept { return _mm_set1_pd(v); }
+  static Reg add(Reg a, Reg b) noexcept { return _mm_add_pd(a, b); }
+  static Reg sub(Reg a, Reg b) noexcept { return _mm_sub_pd(a, b); }
+  static Reg mul(Reg a, Reg b) noexcept { return _mm_mul_pd(a, b); }
+  static Reg max(Reg a, Reg b) noexcept { return _mm_max_pd(a, b); }
+  static Reg abs(Reg a) noexcept {
+    return _mm_andnot_pd(_mm_set1_pd(-0.), a);
+  }
+  static Mask gt(Reg a, Reg b) noexcept {
+    return _mm_movemask_pd(_mm_cmpgt_pd(a, b));
+  }
+  static Mask lt(Reg a, Reg b) noexcept {
+    return _mm_movemask_pd(_mm_cmplt_pd(a, b));
+  }
+};
+#endif
+
+#if defined(__AVX2__) || defined(GEOMETRY_SIMD_DISPATCH)
+GEOMETRY_TARGET_BEGIN("avx2")
+struct Avx2Float final {
+  using Value = float;
+  using Reg = __m256;
+  static constexpr unsigned kWidth = 8;
+
+  static Reg load(const float* p) noexcept { return _mm256_loadu_ps(p); }
+  static Reg set1(float v) noexcept { return _mm256_set1_ps(v); }
+  static Reg add(Reg a, Reg b) noexcept { return _mm256_add_ps(a, b); }
+  static Reg sub(Reg a, Reg b) noexcept { return _mm256_sub_ps(a, b); }
+  static Reg mul(Reg a, Reg b) noexcept { return _mm256_mul_ps(a, b); }
+  static Reg max(Reg a, Reg b) noexcept { return _mm256_max_ps(a, b); }
+  static Reg abs(Reg a) noexcept {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a);
+  }
+  static Mask gt(Reg a, Reg b) noexcept {
+    return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ));
+  }
+  static Mask lt(Reg a, Reg b) noexcept {
+    return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ));
+  }
+};
+
+struct Avx2Double final {
+  using Value = double;
+  using Reg = __m256d;
+  static constexpr unsigned kWidth = 4;
+
+  static Reg load(const double* p) noexcept { return _mm256_loadu_pd(p); }
+  static Reg set1(double v) noexcept { return _mm256_set1_pd(v); }
+  static Reg add(Reg a, Reg b) noexcept { return _mm256_add_pd(a, b); }
+  static Reg sub(Reg a, Reg b) noexcept { return _mm256_sub_pd(a, b); }
+  static Reg mul(Reg a, Reg b) noexcept { return _mm256_mul_pd(a, b); }
+  static Reg max(Reg a, Reg b) noexcept { return _mm256_max_pd(a, b); }
+  static Reg abs(Reg a) noexcept {
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.), a);
+  }
+  static Mask gt(Reg a, Reg b) noexcept {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_GT_OQ));
+  }
+  static Mask lt(Reg a, Reg b) noexcept {
+    return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ));
+  }
+};
+GEOMETRY_TARGET_END()
+#endif
+
+#if defined(__AVX512F__) || defined(GEOMETRY_SIMD_DISPATCH)
+GEOMETRY_TARGET_BEGIN("avx512f,avx512bw")
+struct Avx512Float final {
+  using Value = float;
+  using Reg = __m512;
+  static constexpr unsigned kWidth = 16;
+
+  static Reg load(const float* p) noexcept { return _mm512_loadu_ps(p); }
+  static Reg set1(float v) noexcept { return _mm512_set1_ps(v); }
+  static Reg add(Reg a, Reg b) noexcept { return _mm512_add_ps(a, b); }
+  static Reg sub(Reg a, Reg b) noexcept { return _mm512_sub_ps(a, b); }
+  static Reg mul(Reg a, Reg b) noexcept { return _mm512_mul_ps(a, b); }
+  // all lanes from the masked form, the plain one starts from an undefined
+  // register which GCC 12 warns about
+  static Reg max(Reg a, Reg b) noexcept {
+    return _mm512_mask_max_ps(a, 0xffff, a, b);
+  }
+  static Reg abs(Reg a) noexcept { return _mm512_abs_ps(a); }
+  static Mask gt(Reg a, Reg b) noexcept {
+    return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ);
+  }
+  static Mask lt(Reg a, Reg b) noexcept {
+    return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ);
+  }
+};
+
+struct Avx512Double final {
+  using Value = double;
+  using Reg = __m512d;
+  static constexpr unsigned kWidth = 8;
+
+  static Reg load(const double* p) noexcept { return _mm512_loadu_pd(p); }
+  static Reg set1(double v) noexcept { return _mm512_set1_pd(v); }
+  static Reg add(Reg a, Reg b) noexcept { return _mm512_add_pd(a, b); }
+  static Reg sub(Reg a, Reg b) noexcept { return _mm512_sub_pd(a, b); }
+  static Reg mul(Reg a, Reg b) noexcept { return _mm512_mul_pd(a, b); }
+  static Reg max(Reg a, Reg b) noexcept {
+    return _mm512_mask_max_pd(a, 0xff, a, b);
+  }
+  static Reg abs(Reg a) noexcept { return _mm512_abs_pd(a); }
+  static Mask gt(Reg a, Reg b) noexcept {
+    return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);
+  }
+  static Mask lt(Reg a, Reg b) noexcept {
+    return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ);
+  }
+};
+GEOMETRY_TARGET_END()
+#endif
+
+/**
+ * Widest wrapper available for the target the code is compiled for.
+ */
+template <typename T>
+struct NativeFor final {
+  using type = Scalar<T>;
+};
+
+#if defined(__AVX512F__)
+template <>
+struct NativeFor<float> final {
+  using type = Avx512Float;
+};
+template <>
+struct NativeFor<double> final {
+  using type = Avx512Double;
+};
+#elif defined(__AVX2__)
+template <>
+struct NativeFor<float> final {
+  using type = Avx2Float;
+};
+template <>
+struct NativeFor<double> final {
+  using type = Avx2Double;
+};
+#elif defined(__SSE2__)
+template <>
+struct NativeFor<float> final {
+  using type = SseFloat;
+};
+template <>
+struct NativeFor<double> final {
+  using type = SseDouble;
+};
+#endif
+
+template <typename T>
+using Native = typename NativeFor<T>::type;
+
+/** widest register in lanes of any wrapper, used for padding */
+inline constexpr unsigned kMaxWidth = 16;
+
+/**
+ * Registers holding a single 3D vector as lanes x, y, z and a pad lane.
+ * Besides lane wise arithmetic they rotate lanes for cross products and
+ * reduce the first three lanes for dot products and comparisons. Lanes are
+ * combined in the order of the scalar code, so results are the same unless
+ * the compiler contracts scalar multiply-adds.
+ */
+template <typename T>
+struct ScalarXyz final {
+  using Value = T;
+  using Reg = std::array<T, 4>;
+
+  static Reg set(T x, T y, T z) noexcept { return {x, y, z, 0}; }
+  static Reg set1(T v) noexcept { return {v, v, v, v}; }
+  static T get(const Reg& a, unsigned i) noexcept { return a[i]; }
+
+  template <typename F>
+  static Reg map(const Reg& a, const Reg& b, F f) noexcept {
+    return {f(a[0], b[0]), f(a[1], b[1]), f(a[2], b[2]), f(a[3], b[3])};
+  }
+  static Reg add(const Reg& a, const Reg& b) noexcept {
+    return map(a, b, [](T x, T y) { return x + y; });
+  }
+  static Reg sub(const Reg& a, const Reg& b) noexcept {
+    return map(a, b, [](T x, T y) { return x - y; });
+  }
+  static Reg mul(const Reg& a, const Reg& b) noexcept {
+    return map(a, b, [](T x, T y) { return x * y; });
+  }
+  static Reg div(const Reg& a, const Reg& b) noexcept {
+    return map(a, b, [](T x, T y) { return x / y; });
+  }
+  static Reg max(const Reg& a, const Reg& b) noexcept {
+    return map(a, b, [](T x, T y) { return x > y ? x : y; });
+  }
+  static Reg abs(const Reg& a) noexcept {
+    return {std::abs(a[0]), std::abs(a[1]), std::abs(a[2]), std::abs(a[3])};
+  }
+  /** (y, z, x) and (z, x, y) */
+  static Reg yzx(const Reg& a) noexcept { return {a[1], a[2], a[0], a[3]}; }
+  static Reg zxy(const Reg& a) noexcept { return {a[2], a[0], a[1], a[3]}; }
+  /** (x + y) + z */
+  static T sum3(const Reg& a) noexcept { return a[0] + a[1] + a[2]; }
+  /** whether a <= b in all of x, y, z, false for NaN */
+  static bool le3(const Reg& a, const Reg& b) noexcept {
+    return a[0] <= b[0] && a[1] <= b[1] && a[2] <= b[2];
+  }
+};
+
+#if defined(__SSE2__)
+struct SseFloatXyz final {
+  using Value = float;
+  using Reg = __m128;
+
+  static Reg set(float x, float y, float z) noexcept {
+    return _mm_setr_ps(x, y, z, 0);
+  }
+  static Reg set1(float v) noexcept { return _mm_set1_ps(v); }
+  static float get(Reg a, unsigned i) noexcept {
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, a);
+    return lanes[i];
+  }
+
+  static Reg add(Reg a, Reg b) noexcept { return _mm_add_ps(a, b); }
+  static Reg sub(Reg a, Reg b) noexcept { return _mm_sub_ps(a, b); }
+  static Reg mul(Reg a, Reg b) noexcept { return _mm_mul_ps(a, b); }
+  static Reg div(Reg a, Reg b) noexcept { return _mm_div_ps(a, b); }
+  static Reg max(Reg a, Reg b) noexcept { return _mm_max_ps(a, b); }
+  static Reg abs(Reg a) noexcept {
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), a);
+  }
+  static Reg yzx(Reg a) noexcept {
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+  }
+  static Reg zxy(Reg a) noexcept {
+    return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+  }
+  static float sum3(Reg a) noexcept {
+    auto y = _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1));
+    auto z = _mm_movehl_ps(a, a);
+    return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(a, y), z));
+  }
+  static bool le3(Reg a, Reg b) noexcept {
+    return (_mm_movemask_ps(_mm_cmple_ps(a, b)) & 7) == 7;
+  }
+};
+
+/** two registers, (x, y) and (z, padding) */
+struct SseDoubleXyz final {
+  using Value = double;
+  struct Reg {
+    __m128d xy, zw;
+  };
+
+  static Reg set(double x, double y, double z) noexcept {
+    return {_mm_setr_pd(x, y), _mm_setr_pd(z, 0)};
+  }
+  static Reg set1(double v) noexcept {
+    return {_mm_set1_pd(v), _mm_set1_pd(v)};
+  }
+  static double get(const Reg& a, unsigned i) noexcept {
+    alignas(16) double lanes[4];
+    _mm_store_pd(lanes, a.xy);
+    _mm_store_pd(lanes + 2, a.zw);
+    return lanes[i];
+  }
+
+  static Reg add(const Reg& a, const Reg& b) noexcept {
+    return {_mm_add_pd(a.xy, b.xy), _mm_add_pd(a.zw, b.zw)};
+  }
+  static Reg sub(const Reg& a, const Reg& b) noexcept {
+    return {_mm_sub_pd(a.xy, b.xy), _mm_sub_pd(a.zw, b.zw)};
+  }
+  static Reg mul(const Reg& a, const Reg& b) noexcept {
+    return {_mm_mul_pd(a.xy, b.xy), _mm_mul_pd(a.zw, b.zw)};
+  }
+  static Reg div(const Reg& a, const Reg& b) noexcept {
+    return {_mm_div_pd(a.xy, b.xy), _mm_div_pd(a.zw, b.zw)};
+  }
+  static Reg max(const Reg& a, const Reg& b) noexcept {
+    return {_mm_max_pd(a.xy, b.xy), _mm_max_pd(a.zw, b.zw)};
+  }
+  static Reg abs(const Reg& a) noexcept {
+    auto sign = _mm_set1_pd(-0.);
+    return {_mm_andnot_pd(sign, a.xy), _mm_andnot_pd(sign, a.zw)};
+  }
+  static Reg yzx(const Reg& a) noexcept {
+    return {_mm_shuffle_pd(a.xy, a.zw, 1), _mm_shuffle_pd(a.xy, a.zw, 2)};
+  }
+  static Reg zxy(const Reg& a) noexcept {
+    return {_mm_shuffle_pd(a.zw, a.xy, 0), _mm_shuffle_pd(a.xy, a.zw, 3)};
+  }
+  static double sum3(const Reg& a) noexcept {
+    auto y = _mm_unpackhi_pd(a.xy, a.xy);
+    return _mm_cvtsd_f64(_mm_add_sd(_mm_add_sd(a.xy, y), a.zw));
+  }
+  static bool le3(const Reg& a, const Reg& b) noexcept {
+    return _mm_movemask_pd(_mm_cmple_pd(a.xy, b.xy)) == 3 &&
+           (_mm_movemask_pd(_mm_cmple_pd(a.zw, b.zw)) & 1) != 0;
+  }
+};
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+struct NeonFloatXyz final {
+  using Value = float;
+  using Reg = float32x4_t;
+
+  static Reg set(float x, float y, float z) noexcept {
+    const float lanes[4] = {x, y, z, 0};
+    return vld1q_f32(lanes);
+  }
+  static Reg set1(float v) noexcept { return vdupq_n_f32(v); }
+  static float get(Reg a, unsigned i) noexcept {
+    float lanes[4];
+    vst1q_f32(lanes, a);
+    return lanes[i];
+  }
+
+  static Reg add(Reg a, Reg b) noexcept { return vaddq_f32(a, b); }
+  static Reg sub(Reg a, Reg b) noexcept { return vsubq_f32(a, b); }
+  static Reg mul(Reg a, Reg b) noexcept { return vmulq_f32(a, b); }
+  static Reg div(Reg a, Reg b) noexcept { return vdivq_f32(a, b); }
+  /** vmaxq_f32() gives NaN for NaN, the scalar code gives b */
+  static Reg max(Reg a, Reg b) noexcept {
+    return vbslq_f32(vcgtq_f32(a, b), a, b);
+  }
+  static Reg abs(Reg a) noexcept { return vabsq_f32(a); }
+  static Reg yzx(Reg a) noexcept {
+    auto r = vcopyq_laneq_f32(vextq_f32(a, a, 1), 2, a, 0);
+    return vcopyq_laneq_f32(r, 3, a, 3);
+  }
+  static Reg zxy(Reg a) noexcept {
+    auto r = vcopyq_laneq_f32(vextq_f32(a, a, 3), 0, a, 2);
+    return vcopyq_laneq_f32(r, 3, a, 3);
+  }
+  static float sum3(Reg a) noexcept {
+    return vgetq_lane_f32(a, 0) + vgetq_lane_f32(a, 1) + vgetq_lane_f32(a, 2);
+  }
+  static bool le3(Reg a, Reg b) noexcept {
+    auto m = vcleq_f32(a, b);
+    return (vgetq_lane_u32(m, 0) & vgetq_lane_u32(m, 1) &
+            vgetq_lane_u32(m, 2)) != 0;
+  }
+};
+
+/** two registers, (x, y) and (z, padding) */
+struct NeonDoubleXyz final {
+  using Value = double;
+  struct Reg {
+    float64x2_t xy, zw;
+  };
+
+  static Reg set(double x, double y, double z) noexcept {
+    const double lanes[4] = {x, y, z, 0};
+    return {vld1q_f64(lanes), vld1q_f64(lanes + 2)};
+  }
+  static Reg set1(double v) noexcept {
+    return {vdupq_n_f64(v), vdupq_n_f64(v)};
+  }
+  static double get(const Reg& a, unsigned i) noexcept {
+    double lanes[4];
+    vst1q_f64(lanes, a.xy);
+    vst1q_f64(lanes + 2, a.zw);
+    return lanes[i];
+  }
+
+  static Reg add(const Reg& a, const Reg& b) noexcept {
+    return {vaddq_f64(a.xy, b.xy), vaddq_f64(a.zw, b.zw)};
+  }
+  static Reg sub(const Reg& a, const Reg& b) noexcept {
+    return {vsubq_f64(a.xy, b.xy), vsubq_f64(a.zw, b.zw)};
+  }
+  static Reg mul(const Reg& a, const Reg& b) noexcept {
+    return {vmulq_f64(a.xy, b.xy), vmulq_f64(a.zw, b.zw)};
+  }
+  static Reg div(const Reg& a, const Reg& b) noexcept {
+    return {vdivq_f64(a.xy, b.xy), vdivq_f64(a.zw, b.zw)};
+  }
+  static Reg max(const Reg& a, const Reg& b) noexcept {
+    return {vbslq_f64(vcgtq_f64(a.xy, b.xy), a.xy, b.xy),
+            vbslq_f64(vcgtq_f64(a.zw, b.zw), a.zw, b.zw)};
+  }
+  static Reg abs(const Reg& a) noexcept {
+    return {vabsq_f64(a.xy), vabsq_f64(a.zw)};
+  }
+  static Reg yzx(const Reg& a) noexcept {
+    return {vextq_f64(a.xy, a.zw, 1), vcopyq_laneq_f64(a.zw, 0, a.xy, 0)};
+  }
+  static Reg zxy(const Reg& a) noexcept {
+    return {vzip1q_f64(a.zw, a.xy), vcopyq_laneq_f64(a.zw, 0, a.xy, 1)};
+  }
+  static double sum3(const Reg& a) noexcept {
+    return vgetq_lane_f64(a.xy, 0) + vgetq_lane_f64(a.xy, 1) +
+           vgetq_lane_f64(a.zw, 0);
+  }
+  static bool le3(const Reg& a, const Reg& b) noexcept {
+    auto xy = vcleq_f64(a.xy, b.xy);
+    auto zw = vcleq_f64(a.zw, b.zw);
+    return (vgetq_lane_u64(xy, 0) & vgetq_lane_u64(xy, 1) &
+            vgetq_lane_u64(zw, 0)) != 0;
+  }
+};
+#endif
+
+#if defined(__AVX2__)
+struct Avx2DoubleXyz final {
+  using Value = double;
+  using Reg = __m256d;
+
+  static Reg set(double x, double y, double z) noexcept {
+    return _mm256_setr_pd(x, y, z, 0);
+  }
+  static Reg set1(double v) noexcept { return _mm256_set1_pd(v); }
+  static double get(Reg a, unsigned i) noexcept {
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, a);
+    return lanes[i];
+  }
+
+  static Reg add(Reg a, Reg b) noexcept { return _mm256_add_pd(a, b); }
+  static Reg sub(Reg a, Reg b) noexcept { return _mm256_sub_pd(a, b); }
+  static Reg mul(Reg a, Reg b) noexcept { return _mm256_mul_pd(a, b); }
+  static Reg div(Reg a, Reg b) noexcept { return _mm256_div_pd(a, b); }
+  static Reg max(Reg a, Reg b) noexcept { return _mm256_max_pd(a, b); }
+  static Reg abs(Reg a) noexcept {
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.), a);
+  }
+  static Reg yzx(Reg a) noexcept {
+    return _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 0, 2, 1));
+  }
+  static Reg zxy(Reg a) noexcept {
+    return _mm256_permute4x64_pd(a, _MM_SHUFFLE(3, 1, 0, 2));
+  }
+  static double sum3(Reg a) noexcept {
+    auto xy = _mm256_castpd256_pd128(a);
+    auto y = _mm_unpackhi_pd(xy, xy);
+    auto z = _mm256_extractf128_pd(a, 1);
+    return _mm_cvtsd_f64(_mm_add_sd(_mm_add_sd(xy, y), z));
+  }
+  static bool le3(Reg a, Reg b) noexcept {
+    return (_mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LE_OQ)) & 7) == 7;
+  }
+};
+#endif
+
+/**
+ * Four lane wrapper for single vectors: one register of four lanes, two of
+ * two lanes for double without AVX2, scalar lanes on other targets.
+ */
+template <typename T>
+struct XyzFor final {
+  using type = ScalarXyz<T>;
+};
+
+#if defined(__SSE2__)
+template <>
+struct XyzFor<float> final {
+  using type = SseFloatXyz;
+};
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+template <>
+struct XyzFor<float> final {
+  using type = NeonFloatXyz;
+};
+#endif
+
+#if defined(__AVX2__)
+template <>
+struct XyzFor<double> final {
+  using type = Avx2DoubleXyz;
+};
+#elif defined(__SSE2__)
+template <>
+struct XyzFor<double> final {
+  using type = SseDoubleXyz;
+};
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+template <>
+struct XyzFor<double> final {
+  using type = NeonDoubleXyz;
+};
+#endif
+
+template <typename T>
+using Xyz = typename XyzFor<T>::type;
+
+}  // namespace simd
+
+}  // namespace geometry
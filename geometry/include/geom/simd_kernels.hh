@@ -0,0 +1,160 @@
+// Kernels of runtime dispatch. dispatch.hh includes this file once per
+// instruction set, inside the namespace of that set where Wide<T> names its
+// widest wrapper, so there is no include guard.
+
+/**
+ * Bit i is set if box k + i overlaps box [min, max], for i in [0, kBlock).
+ * Lanes are min x/y/z and max x/y/z of QuantizedBoxes. Loops over fixed
+ * blocks of small integers compile to vector compares of the set.
+ */
+inline std::uint32_t overlappingBoxes(const std::uint16_t* data,
+                                      std::size_t stride, std::size_t k,
+                                      const std::uint16_t* min,
+                                      const std::uint16_t* max) noexcept {
+  auto lane = [data, stride, k](int l) { return data + l * stride + k; };
+  auto min_x = lane(0), min_y = lane(1), min_z = lane(2);
+  auto max_x = lane(3), max_y = lane(4), max_z = lane(5);
+  std::uint8_t hit[kBlock];
+  for (unsigned i = 0; i < kBlock; ++i) {
+    hit[i] = (min_x[i] <= max[0]) & (min[0] <= max_x[i]) &
+             (min_y[i] <= max[1]) & (min[1] <= max_y[i]) &
+             (min_z[i] <= max[2]) & (min[2] <= max_z[i]);
+  }
+  // the multiplication gathers lowest bits of eight bytes in the top one
+  std::uint32_t res = 0;
+  for (unsigned i = 0; i < kBlock; i += 8) {
+    std::uint64_t bytes;
+    std::memcpy(&bytes, hit + i, sizeof(bytes));
+    res |= static_cast<std::uint32_t>((bytes * 0x0102040810204080) >> 56)
+           << i;
+  }
+  return res;
+}
+
+/**
+ * TriangleQuery broadcast to registers.
+ */
+template <typename V>
+struct BatchQuery final {
+  using Reg = typename V::Reg;
+
+  explicit BatchQuery(const TriangleQuery<typename V::Value>& q) noexcept {
+    for (auto l = 0; l < kTriangleLanes; ++l) {
+      v_[l] = V::set1(q.v_[l]);
+    }
+    for (auto l = 0; l < 3; ++l) {
+      n_[l] = V::set1(q.n_[l]);
+    }
+    n2_ = V::set1(q.n2_);
+    err_ = V::set1(q.err_);
+    scale_ = V::set1(q.scale_);
+  }
+
+  Reg v_[kTriangleLanes];
+  Reg n_[3];
+  Reg n2_, err_, scale_;
+};
+
+template <typename V>
+typename V::Reg dot(const typename V::Reg* n, typename V::Reg x,
+                    typename V::Reg y, typename V::Reg z) noexcept {
+  return V::add(V::add(V::mul(n[0], x), V::mul(n[1], y)), V::mul(n[2], z));
+}
+
+/**
+ * Lanes whose three distances d are all outside the band and of one sign.
+ */
+template <typename V>
+Mask separated(typename V::Reg d0, typename V::Reg d1, typename V::Reg d2,
+               typename V::Reg bound2) noexcept {
+  auto zero = V::set1(0);
+  auto out = V::gt(V::mul(d0, d0), bound2) & V::gt(V::mul(d1, d1), bound2) &
+             V::gt(V::mul(d2, d2), bound2);
+  auto pos = V::gt(d0, zero) & V::gt(d1, zero) & V::gt(d2, zero);
+  auto neg = V::lt(d0, zero) & V::lt(d1, zero) & V::lt(d2, zero);
+  return out & (pos | neg);
+}
+
+/**
+ * Same bounds as RawPlane::sides(), computed for all lanes at once.
+ */
+template <typename V>
+typename V::Reg bound2(typename V::Reg band, typename V::Reg n2,
+                       typename V::Reg err, typename V::Reg scale) noexcept {
+  using T = typename V::Value;
+  constexpr auto kEps = std::numeric_limits<T>::epsilon();
+  auto rounding = V::mul(V::mul(V::set1(16 * kEps), err), scale);
+  auto tol = V::mul(V::mul(band, band), n2);
+  return V::mul(V::set1(2), V::add(tol, V::mul(rounding, rounding)));
+}
+
+/**
+ * Lanes of the register at k of TriangleBatch data which are not rejected
+ * by the plane sign tests of intersectsInterval() against the query.
+ */
+template <typename V>
+Mask batchCandidates(const BatchQuery<V>& q,
+                     const typename V::Value* data, std::size_t stride,
+                     std::size_t k) noexcept {
+  using T = typename V::Value;
+  using Reg = typename V::Reg;
+  Reg v[kTriangleLanes];
+  auto scale = q.scale_;
+  for (auto l = 0; l < kTriangleLanes; ++l) {
+    v[l] = V::load(data + l * stride + k);
+    scale = V::max(scale, V::abs(v[l]));
+  }
+  // comparator::kernelBand() of every lane
+  auto band = V::mul(
+      V::set1(16), V::max(V::set1(comparator::kAbsTol<T>),
+                          V::mul(V::set1(comparator::kRelTol<T>), scale)));
+
+  // lane triangles against plane of the single one
+  auto d = [&q, &v](int x) {
+    return dot<V>(q.n_, V::sub(v[x], q.v_[kAx]), V::sub(v[x + 1], q.v_[kAy]),
+                  V::sub(v[x + 2], q.v_[kAz]));
+  };
+  auto rejected = separated<V>(d(kAx), d(kBx), d(kCx),
+                               bound2<V>(band, q.n2_, q.err_, scale));
+
+  // the single triangle against planes of lane ones
+  Reg e1[3] = {V::sub(v[kBx], v[kAx]), V::sub(v[kBy], v[kAy]),
+               V::sub(v[kBz], v[kAz])};
+  Reg e2[3] = {V::sub(v[kCx], v[kAx]), V::sub(v[kCy], v[kAy]),
+               V::sub(v[kCz], v[kAz])};
+  Reg n[3] = {V::sub(V::mul(e1[1], e2[2]), V::mul(e1[2], e2[1])),
+              V::sub(V::mul(e1[2], e2[0]), V::mul(e1[0], e2[2])),
+              V::sub(V::mul(e1[0], e2[1]), V::mul(e1[1], e2[0]))};
+  auto n2 = dot<V>(n, n[0], n[1], n[2]);
+  auto err = V::mul(V::set1(0.5), V::add(dot<V>(e1, e1[0], e1[1], e1[2]),
+                                        dot<V>(e2, e2[0], e2[1], e2[2])));
+  auto du = [&q, &v, &n](int x) {
+    return dot<V>(n, V::sub(q.v_[x], v[kAx]), V::sub(q.v_[x + 1], v[kAy]),
+                  V::sub(q.v_[x + 2], v[kAz]));
+  };
+  rejected |= separated<V>(du(kAx), du(kBx), du(kCx),
+                           bound2<V>(band, n2, err, scale));
+  return ~rejected;
+}
+
+/**
+ * Candidates among kBlock lanes from k, only picked ones are tested and
+ * registers without any of them are not loaded.
+ */
+template <typename T>
+std::uint32_t batchCandidatesBlock(const TriangleQuery<T>& query,
+                                   const T* data, std::size_t stride,
+                                   std::size_t k,
+                                   std::uint32_t picked) noexcept {
+  using V = Wide<T>;
+  static_assert(kBlock % V::kWidth == 0);
+  constexpr auto kLanes = (std::uint32_t{1} << V::kWidth) - 1;
+  BatchQuery<V> q(query);
+  std::uint32_t res = 0;
+  for (unsigned i = 0; i < kBlock; i += V::kWidth) {
+    if (auto lanes = (picked >> i) & kLanes) {
+      res |= (batchCandidates<V>(q, data, stride, k + i) & lanes) << i;
+    }
+  }
+  return res;
+}
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <limits>
 
 #include "plane.hh"
 #include "segment3d.hh"
@@ -30,7 +32,12 @@ struct Triangle3D final {
   }
 
   bool isDegenerate() const noexcept { return Plane<T>(a_, b_, c_).valid(); }
-  T area() const { return crossProduct(a_ - b_, a_ - c_).norm() / 2; }
+  T area() const {
+    PackedVector3D<T> a(a_);
+    return crossProduct(a - PackedVector3D<T>(b_), a - PackedVector3D<T>(c_))
+               .norm() /
+           2;
+  }
 
   /**
    * Returns a minimal range containing the whole triangle.
@@ -44,6 +51,75 @@ struct Triangle3D final {
   }
 
   bool contains(const Vector3D<T>& point) const noexcept {
+    auto plane = getPlane();
+    return plane.valid() ? contains(point, plane) : containsByArea(point);
+  }
+
+  /**
+   * Point-in-triangle test by signs, plane is the valid plane of this
+   * triangle. The point has to lie on the plane and on the inner side of
+   * every edge, both within tolerance. Edges are tested with 2D cross
+   * products in the projection dropping dominant axis of the normal, so
+   * there are no square roots or divisions. Edge tolerance is the one of the
+   * area test: the areas cut by the point may exceed the triangle area by
+   * the comparator tolerance.
+   */
+  bool contains(const Vector3D<T>& point, const Plane<T>& plane) const
+      noexcept {
+    constexpr auto kEps = std::numeric_limits<T>::epsilon();
+    constexpr auto kRel = comparator::kRelTol<T>;
+    constexpr auto kAbs = comparator::kAbsTol<T>;
+
+    // (u, v, k) is a cyclic permutation of (x, y, z), so 2D cross products
+    // of projections are k-th components of the 3D ones
+    auto&& n = plane.normal();
+    auto ax = std::abs(n.x_), ay = std::abs(n.y_), az = std::abs(n.z_);
+    auto k = ax >= ay && ax >= az ? 0 : ay >= az ? 1 : 2;
+    auto project = [k](const Vector3D<T>& p) {
+      return k == 0   ? std::array<T, 2>{p.y_, p.z_}
+             : k == 1 ? std::array<T, 2>{p.z_, p.x_}
+                      : std::array<T, 2>{p.x_, p.y_};
+    };
+    auto pa = project(a_), pb = project(b_), pc = project(c_);
+    auto pp = project(point);
+    auto cross = [](const std::array<T, 2>& from, const std::array<T, 2>& to,
+                    const std::array<T, 2>& p) {
+      return (to[0] - from[0]) * (p[1] - from[1]) -
+             (to[1] - from[1]) * (p[0] - from[0]);
+    };
+
+    // twice the area times n_k, its sign gives orientation of the projection
+    auto doubled = cross(pa, pb, pc);
+    auto n_k = std::max({ax, ay, az});
+    // (e x w)_k = |e| * distance to edge line * n_k, the area test allows
+    // |e| * distance up to tolerance of the area. Rounding is bound for
+    // points next to the triangle, far ones fail some other edge anyway.
+    auto extent = std::abs(pb[0] - pa[0]) + std::abs(pb[1] - pa[1]) +
+                  std::abs(pc[0] - pa[0]) + std::abs(pc[1] - pa[1]);
+    auto tol = std::max(kRel * std::abs(doubled) / 2, kAbs * n_k) +
+               16 * kEps * extent * extent;
+    auto inner = [&](const std::array<T, 2>& from,
+                     const std::array<T, 2>& to) {
+      auto side = doubled < 0 ? -cross(from, to, pp) : cross(from, to, pp);
+      return side >= -tol;
+    };
+    // no short circuit, signs of random points are hard to predict
+    if (!(inner(pa, pb) & inner(pb, pc) & inner(pc, pa))) {
+      return false;
+    }
+
+    // distance to plane, NaN point fails here
+    auto scale = std::max({std::abs(point.x_), std::abs(point.y_),
+                           std::abs(point.z_), std::abs(plane.distance())});
+    auto h = dot(n, point) - plane.distance();
+    return std::abs(h) <= comparator::kernelBand(scale);
+  }
+
+  /**
+   * Area test: areas of triangles cut by the point sum up to the area of
+   * the whole triangle. Works for degenerate triangles too.
+   */
+  bool containsByArea(const Vector3D<T>& point) const noexcept {
     Triangle3D<T> t1{a_, b_, point};
     Triangle3D<T> t2{b_, c_, point};
     Triangle3D<T> t3{a_, c_, point};
@@ -74,8 +150,17 @@ struct Triangle3D final {
   }
 
   bool intersectsInPlane(const Triangle3D<T>& other) const noexcept {
-    return contains(other.a_) || contains(other.b_) || contains(other.c_) ||
-           other.contains(a_) || other.contains(b_) || other.contains(c_) ||
+    return intersectsInPlane(other, getPlane(), other.getPlane());
+  }
+
+  /**
+   * Same as above with valid planes of both triangles.
+   */
+  bool intersectsInPlane(const Triangle3D<T>& other, const Plane<T>& this_p,
+                         const Plane<T>& other_p) const noexcept {
+    return contains(other.a_, this_p) || contains(other.b_, this_p) ||
+           contains(other.c_, this_p) || other.contains(a_, other_p) ||
+           other.contains(b_, other_p) || other.contains(c_, other_p) ||
            intersectsEdges(other);
   }
 
@@ -83,13 +168,24 @@ struct Triangle3D final {
     return contains(seg.begin_) || contains(seg.end_) || intersectsEdges(seg);
   }
 
+  bool intersectsInPlane(const Segment3D<T>& seg,
+                         const Plane<T>& plane) const noexcept {
+    return contains(seg.begin_, plane) || contains(seg.end_, plane) ||
+           intersectsEdges(seg);
+  }
+
   auto getPlane() const noexcept { return Plane<T>(a_, b_, c_); }
   auto normal() const noexcept { return getPlane().normal(); }
 
   bool intersects(const Triangle3D<T>& other) const noexcept {
-    auto this_p = Plane<T>(a_, b_, c_);
-    auto other_p = Plane<T>(other.a_, other.b_, other.c_);
+    return intersects(other, getPlane(), other.getPlane());
+  }
 
+  /**
+   * Same as above with planes of both triangles computed in advance.
+   */
+  bool intersects(const Triangle3D<T>& other, const Plane<T>& this_p,
+                  const Plane<T>& other_p) const noexcept {
     auto this_valid = this_p.valid();
     auto other_valid = other_p.valid();
 
@@ -102,26 +198,34 @@ struct Triangle3D final {
     if (this_valid && !other_valid) {
       auto seg = other.toSegment3D();
       if (this_p.contains(seg)) {
-        return intersectsInPlane(seg);
+        return intersectsInPlane(seg, this_p);
       }
       auto intersection = this_p.getIntersectionPoint(seg);
-      return contains(intersection);
+      return contains(intersection, this_p);
     }
 
     if (!this_valid && other_valid) {
       auto seg = toSegment3D();
       if (other_p.contains(seg)) {
-        return other.intersectsInPlane(seg);
+        return other.intersectsInPlane(seg, other_p);
       }
       auto intersection = other_p.getIntersectionPoint(seg);
-      return other.contains(intersection);
+      return other.contains(intersection, other_p);
     }
 
     // planes are coincident with floating point tolerance
     if (this_p.isClose(other_p)) {
-      return intersectsInPlane(other);
+      return intersectsInPlane(other, this_p, other_p);
     }
+    return intersectsCrossing(other, this_p, other_p);
+  }
 
+  /**
+   * Proper triangles with planes that are not coincident intersect iff an
+   * edge of one of them pierces the other one.
+   */
+  bool intersectsCrossing(const Triangle3D<T>& other, const Plane<T>& this_p,
+                          const Plane<T>& other_p) const noexcept {
     Segment3D<T> ab{a_, b_};
     Segment3D<T> bc{b_, c_};
     Segment3D<T> ac{a_, c_};
@@ -138,11 +242,27 @@ struct Triangle3D final {
     auto obci = this_p.getIntersectionPoint(obc);
     auto oaci = this_p.getIntersectionPoint(oac);
 
-    return other.contains(abi) || other.contains(bci) || other.contains(aci) ||
-           contains(oabi) || contains(obci) || contains(oaci);
+    return other.contains(abi, other_p) || other.contains(bci, other_p) ||
+           other.contains(aci, other_p) || contains(oabi, this_p) ||
+           contains(obci, this_p) || contains(oaci, this_p);
   }
 };
 
+/**
+ * Range of the triangle grown on each side by the kernel band for its
+ * coordinates, the sum for two triangles is not less than the band of the
+ * pair.
+ */
+template <typename T>
+Range3D<T> paddedRange(const Triangle3D<T>& t) noexcept {
+  auto r = t.getRange();
+  auto margin = comparator::kernelBand(
+      std::max({std::abs(r.min_x_), std::abs(r.max_x_), std::abs(r.min_y_),
+                std::abs(r.max_y_), std::abs(r.min_z_), std::abs(r.max_z_)}));
+  return {r.min_x_ - margin, r.max_x_ + margin, r.min_y_ - margin,
+          r.max_y_ + margin, r.min_z_ - margin, r.max_z_ + margin};
+}
+
 template <typename T>
 std::istream& operator>>(std::istream& is, Triangle3D<T>& t) {
   is >> t.a_ >> t.b_ >> t.c_;
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "dispatch.hh"
+#include "prepared_triangle.hh"
+#include "triangle3d.hh"
+
+namespace geometry {
+
+/**
+ * Triangles stored as structure of arrays, nine coordinate lanes (x/y/z of
+ * a, b and c), for testing one triangle against many with vector registers.
+ */
+template <typename T>
+class TriangleBatch final {
+  using Lane = simd::TriangleLane;
+  static constexpr auto kLanes = simd::kTriangleLanes;
+
+ public:
+  TriangleBatch() = default;
+
+  /**
+   * Fills batch from a range, proj maps elements to triangles.
+   */
+  template <typename It, typename Proj>
+  void assign(It begin, It end, Proj proj) {
+    size_ = std::distance(begin, end);
+    // padding lets a full register be loaded from any position
+    stride_ = size_ + simd::kMaxWidth;
+    data_.assign(kLanes * stride_, 0);
+    for (std::size_t k = 0; begin != end; ++k, ++begin) {
+      const Triangle3D<T>& t = proj(*begin);
+      T coords[kLanes] = {t.a_.x_, t.a_.y_, t.a_.z_, t.b_.x_, t.b_.y_,
+                          t.b_.z_, t.c_.x_, t.c_.y_, t.c_.z_};
+      for (auto l = 0; l < kLanes; ++l) {
+        data_[l * stride_ + k] = coords[l];
+      }
+    }
+  }
+
+  std::size_t size() const noexcept { return size_; }
+
+  Triangle3D<T> operator[](std::size_t k) const noexcept {
+    auto at = [this, k](Lane l) { return data_[l * stride_ + k]; };
+    return {{at(simd::kAx), at(simd::kAy), at(simd::kAz)},
+            {at(simd::kBx), at(simd::kBy), at(simd::kBz)},
+            {at(simd::kCx), at(simd::kCy), at(simd::kCz)}};
+  }
+
+  /**
+   * Calls f(k) in ascending order for every k in [begin, size()) such that
+   * the pair of t and k-th triangle is not rejected by the plane sign tests
+   * of intersectsInterval(). Rejection is decided in registers of the
+   * instruction set picked at runtime, see dispatch.hh, the rest of the
+   * pairs is left to the scalar kernel.
+   */
+  template <typename F>
+  void forEachCandidate(const PreparedTriangle<T>& t, std::size_t begin,
+                        F&& f) const {
+    forEachCandidate(t, begin, f, [](std::size_t, std::uint32_t valid) {
+      return valid;
+    });
+  }
+
+  /**
+   * Same as above for lanes picked by cheaper test first: pre(k, valid)
+   * returns the subset of valid lanes among kBlock lanes from k to be
+   * tested, blocks with none of them are skipped.
+   */
+  template <typename F, typename Pre>
+  void forEachCandidate(const PreparedTriangle<T>& t, std::size_t begin,
+                        F&& f, Pre&& pre) const {
+    auto kernel = simd::activeKernels().template candidates<T>();
+    auto q = query(t);
+    for (auto k = begin; k < size_; k += simd::kBlock) {
+      auto lanes = std::min<std::size_t>(size_ - k, simd::kBlock);
+      auto valid = lanes == simd::kBlock ? ~std::uint32_t{0}
+                                         : (std::uint32_t{1} << lanes) - 1;
+      auto picked = pre(k, valid);
+      if (picked == 0) {
+        continue;
+      }
+      for (auto mask = kernel(q, data_.data(), stride_, k, picked);
+           mask != 0; mask &= mask - 1) {
+        f(k + __builtin_ctz(mask));
+      }
+    }
+  }
+
+  /**
+   * Same with registers of V known at compile time, one register at a time.
+   */
+  template <typename V, typename F>
+  void forEachCandidate(const Triangle3D<T>& t, std::size_t begin,
+                        F&& f) const {
+    forEachCandidate<V>(PreparedTriangle<T>(t), begin, f);
+  }
+
+  template <typename V, typename F>
+  void forEachCandidate(const PreparedTriangle<T>& t, std::size_t begin,
+                        F&& f) const {
+    simd::base::BatchQuery<V> q(query(t));
+    for (auto k = begin; k < size_; k += V::kWidth) {
+      auto lanes = std::min<std::size_t>(size_ - k, V::kWidth);
+      auto valid = (simd::Mask{1} << lanes) - 1;
+      for (auto mask =
+               simd::base::batchCandidates<V>(q, data_.data(), stride_, k) &
+               valid;
+           mask != 0; mask &= mask - 1) {
+        f(k + __builtin_ctz(mask));
+      }
+    }
+  }
+
+ private:
+  static simd::TriangleQuery<T> query(const PreparedTriangle<T>& prepared) {
+    auto&& t = prepared.triangle_;
+    auto&& n = prepared.raw_normal_;
+    return {{t.a_.x_, t.a_.y_, t.a_.z_, t.b_.x_, t.b_.y_, t.b_.z_, t.c_.x_,
+             t.c_.y_, t.c_.z_},
+            {n.x_, n.y_, n.z_},
+            n.norm2(),
+            prepared.raw_normal_err_,
+            prepared.scale_};
+  }
+
+ private:
+  std::vector<T> data_;
+  std::size_t size_ = 0;
+  std::size_t stride_ = 0;
+};
+
+}  // namespace geometry
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace geometry {
+
+/**
+ * Lock-free disjoint set union safe to use from many threads at once.
+ *
+ * Roots are always linked under the root with smaller index, so there is no
+ * rank to keep consistent and the root of every set is its smallest element.
+ * find() compresses paths by halving with relaxed CAS: a failed CAS only means
+ * someone else already shortened the path.
+ */
+class ConcurrentUnionFind final {
+ public:
+  explicit ConcurrentUnionFind(std::size_t size)
+      : parent_(std::make_unique<std::atomic<std::uint32_t>[]>(size)),
+        size_(size) {
+    assert(size <= UINT32_MAX);
+    for (std::size_t i = 0; i < size; ++i) {
+      parent_[i].store(static_cast<std::uint32_t>(i),
+                       std::memory_order_relaxed);
+    }
+  }
+
+  std::uint32_t find(std::uint32_t x) const noexcept {
+    while (true) {
+      auto p = parent_[x].load(std::memory_order_acquire);
+      if (p == x) {
+        return x;
+      }
+      auto gp = parent_[p].load(std::memory_order_acquire);
+      if (p != gp) {
+        parent_[x].compare_exchange_weak(p, gp, std::memory_order_release,
+                                         std::memory_order_relaxed);
+      }
+      x = gp;
+    }
+  }
+
+  void unite(std::uint32_t a, std::uint32_t b) noexcept {
+    while (true) {
+      a = find(a);
+      b = find(b);
+      if (a == b) {
+        return;
+      }
+      if (a < b) {
+        std::swap(a, b);
+      }
+      // a is the larger root, it may have been linked meanwhile
+      if (parent_[a].compare_exchange_strong(a, b, std::memory_order_acq_rel,
+                                             std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+  bool connected(std::uint32_t a, std::uint32_t b) const noexcept {
+    return find(a) == find(b);
+  }
+
+  /**
+   * Returns sets having at least min_size elements keyed by their smallest
+   * element. Must not run concurrently with unite().
+   */
+  std::map<std::size_t, std::vector<std::size_t>> components(
+      std::size_t min_size = 2) const {
+    std::vector<std::uint32_t> sizes(size_);
+    for (std::size_t i = 0; i < size_; ++i) {
+      ++sizes[find(i)];
+    }
+
+    std::map<std::size_t, std::vector<std::size_t>> res;
+    for (std::size_t i = 0; i < size_; ++i) {
+      auto root = find(i);
+      if (sizes[root] >= min_size) {
+        res[root].push_back(i);
+      }
+    }
+    return res;
+  }
+
+  auto size() const noexcept { return size_; }
+
+ private:
+  std::unique_ptr<std::atomic<std::uint32_t>[]> parent_;
+  std::size_t size_;
+};
+
+}  // namespace geometry
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <type_traits>
 
@@ -8,11 +9,25 @@
 
 namespace geometry {
 
+/**
+ * Floating point vector, or a point of an integer grid with 32-bit
+ * coordinates. Integer points serve exact predicates only, arithmetic on
+ * them may overflow.
+ */
 template <typename T>
 struct Vector3D final {
-  static_assert(std::is_floating_point_v<T>);
+  static_assert(std::is_floating_point_v<T> || std::is_same_v<T, std::int32_t>);
 
-  T x_ = NAN, y_ = NAN, z_ = NAN;
+  T x_ = unset(), y_ = unset(), z_ = unset();
+
+  /** NaN makes default vectors invalid, integer ones start at the origin */
+  static constexpr T unset() noexcept {
+    if constexpr (std::is_floating_point_v<T>) {
+      return NAN;
+    } else {
+      return 0;
+    }
+  }
 
   bool valid() const noexcept {
     return std::isfinite(x_) && std::isfinite(y_) && std::isfinite(z_);
@@ -5,6 +5,18 @@ import glob
 CURRENT_PATH = os.path.abspath(os.path.dirname(__file__))
 PATH_TO_EXECUTABLE = CURRENT_PATH + '/../../build/driver/triangles'
 PATH_TO_INPUT = [CURRENT_PATH + '/func/input/', CURRENT_PATH + '/bench/input']
+# every option set below must reproduce the reference answers
+OPTIONS = [[], ['--threads', '4'],
+           # small budget to force several buckets on benchmarks
+           ['--out-of-core', '--memory-budget', '1'],
+           ['--workers', '3'], ['--narrow-phase', 'generic'],
+           ['--narrow-phase', 'exact'], ['--precision', 'double'],
+           ['--precision', 'mixed'],
+           ['--precision', 'mixed', '--workers', '2'],
+           ['--isa', 'baseline'],
+           # tiny batches and queue to exercise waiting on both sides
+           ['--pipeline', '--broad-threads', '2', '--threads', '2',
+            '--batch-size', '7', '--queue-depth', '2']]
 
 def ansFilePath(input_path):
   return os.path.join((os.path.dirname(input_path)), os.path.pardir) + "/ans/" + (os.path.basename(input_path).replace('test_', 'ans_').replace('.in', '.out'))
@@ -16,27 +28,132 @@ def getAns(ans_file):
 def test():
   fail = False
 
-  for i in range(len(PATH_TO_INPUT)):
-    for input_path in glob.glob(os.path.join(PATH_TO_INPUT[i], '*')):
-      ans_path = ansFilePath(input_path)
-      with open(input_path, 'r') as input_file:
+  for options in OPTIONS:
+    for i in range(len(PATH_TO_INPUT)):
+      for input_path in glob.glob(os.path.join(PATH_TO_INPUT[i], '*')):
+        ans_path = ansFilePath(input_path)
+        with open(input_path, 'r') as input_file:
+          process = subprocess.run(
+            [PATH_TO_EXECUTABLE] + options,
+            stdin=input_file, text=True, capture_output=True
+          )
+          if process.returncode != 0:
+            raise RuntimeError(f'Driver failed on test {input_path}: {process.stderr}')
+          output = process.stdout
+          ref_output = getAns(ans_path)
+          if (output != ref_output):
+            print(f"Test {input_path} {options} failed\n"
+                  f"Expected: {ref_output}\n"
+                  f"Actual:   {output}\n")
+            fail = True
+          else:
+            print(f"Test {ans_path} {options} passed")
+
+  if fail:
+    raise RuntimeError("End-to-end test failed\n")
+
+def testSequence():
+  fail = False
+
+  # every input replayed as two equal frames must give the same answer twice
+  for input_path in glob.glob(os.path.join(PATH_TO_INPUT[0], '*')):
+    with open(input_path, 'r') as input_file:
+      count, frame = input_file.read().split('\n', 1)
+    process = subprocess.run(
+      [PATH_TO_EXECUTABLE, '--sequence'],
+      input=count + '\n' + frame + '\n' + frame, text=True,
+      capture_output=True
+    )
+    if process.returncode != 0:
+      raise RuntimeError(f'Driver failed on test {input_path}: {process.stderr}')
+    ref_output = getAns(ansFilePath(input_path))
+    if process.stdout != ref_output + '\n' + ref_output:
+      print(f"Sequence test {input_path} failed\n")
+      fail = True
+    else:
+      print(f"Sequence test {input_path} passed")
+
+  if fail:
+    raise RuntimeError("End-to-end sequence test failed\n")
+
+def testMesh():
+  fail = False
+
+  # triangles touching only at shared vertices or edges do not intersect,
+  # indexed inputs hold the same meshes as vertices and faces
+  for options in [[], ['--narrow-phase', 'generic'],
+                  ['--narrow-phase', 'exact'], ['--precision', 'double'],
+                  ['--threads', '4'], ['--pipeline', '--threads', '2']]:
+    for mode, test_dir in [('--mesh', 'mesh'), ('--indexed', 'indexed')]:
+      for input_path in glob.glob(
+          os.path.join(CURRENT_PATH, test_dir, 'input/*')):
+        with open(input_path, 'r') as input_file:
+          process = subprocess.run(
+            [PATH_TO_EXECUTABLE, mode] + options,
+            stdin=input_file, text=True, capture_output=True
+          )
+        if process.returncode != 0:
+          raise RuntimeError(f'Driver failed on test {input_path}: {process.stderr}')
+        if process.stdout != getAns(ansFilePath(input_path)):
+          print(f"Mesh test {input_path} {options} failed\n")
+          fail = True
+        else:
+          print(f"Mesh test {input_path} {options} passed")
+
+  if fail:
+    raise RuntimeError("End-to-end mesh test failed\n")
+
+def testSegments():
+  fail = False
+
+  # pairs are sorted before extraction, so threads do not change the output
+  for options in [[], ['--threads', '4'], ['--precision', 'double']]:
+    for mode, test_dir in [('--segments', 'segments'),
+                           ('--polylines', 'polylines')]:
+      for input_path in glob.glob(
+          os.path.join(CURRENT_PATH, test_dir, 'input/*')):
+        with open(input_path, 'r') as input_file:
+          process = subprocess.run(
+            [PATH_TO_EXECUTABLE, mode] + options,
+            stdin=input_file, text=True, capture_output=True
+          )
+        if process.returncode != 0:
+          raise RuntimeError(f'Driver failed on test {input_path}: {process.stderr}')
+        if process.stdout != getAns(ansFilePath(input_path)):
+          print(f"Segments test {input_path} {options} failed\n")
+          fail = True
+        else:
+          print(f"Segments test {input_path} {options} passed")
+
+  if fail:
+    raise RuntimeError("End-to-end segments test failed\n")
+
+def testInputFile():
+  fail = False
+
+  # plain triangles are mapped and parsed in chunks, other modes read the
+  # file as a stream
+  for options in [[], ['--threads', '4'], ['--precision', 'double'],
+                  ['--out-of-core', '--memory-budget', '1']]:
+    for i in range(len(PATH_TO_INPUT)):
+      for input_path in glob.glob(os.path.join(PATH_TO_INPUT[i], '*')):
         process = subprocess.run(
-          [PATH_TO_EXECUTABLE],
-          stdin=input_file, text=True, capture_output=True
+          [PATH_TO_EXECUTABLE, '--input', input_path] + options,
+          stdin=subprocess.DEVNULL, text=True, capture_output=True
         )
         if process.returncode != 0:
           raise RuntimeError(f'Driver failed on test {input_path}: {process.stderr}')
-        output = process.stdout
-        ref_output = getAns(ans_path)
-        if (output != ref_output):
-          print(f"Test {input_path} failed\n"
-                f"Expected: {ref_output}\n"
-                f"Actual:   {output}\n")
+        if process.stdout != getAns(ansFilePath(input_path)):
+          print(f"Input file test {input_path} {options} failed\n")
           fail = True
         else:
-          print(f"Test {ans_path} passed")
+          print(f"Input file test {input_path} {options} passed")
 
   if fail:
-    raise RuntimeError("End-to-end test failed\n")
+    raise RuntimeError("End-to-end input file test failed\n")
 
 test()
+testSequence()
+testMesh()
+testSegments()
+testInputFile()
@@ -1,8 +1,30 @@
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+
 #include "CGAL/Exact_predicates_exact_constructions_kernel.h"
 #include "CGAL/intersections.h"
+#include "geom/bounded_queue.hh"
+#include "geom/duplicates.hh"
+#include "geom/frame_tracker.hh"
+#include "geom/intersection_segments.hh"
+#include "geom/mesh.hh"
+#include "geom/narrow_phase.hh"
 #include "geom/octree.hh"
+#include "geom/packed_vector3d.hh"
 #include "geom/plane.hh"
+#include "geom/predicates.hh"
+#include "geom/prepared_triangle.hh"
+#include "geom/quantized_box.hh"
+#include "geom/triangle_batch.hh"
 #include "geom/triangle3d.hh"
+#include "geom/union_find.hh"
 #include "geom/vector3d.hh"
 #include "gtest/gtest.h"
 
@@ -38,6 +60,61 @@ TEST(Vector3D, normalize) {
   ASSERT_TRUE(comparator::isClose(n.norm(), 1.0));
 }
 
+template <typename T, typename B>
+void checkPackedMatchesScalar() {
+  using Packed = PackedVector3D<T, B>;
+  std::mt19937 gen(41);
+  std::uniform_real_distribution<T> coord(-100, 100);
+  auto random = [&] {
+    return Vector3D<T>{coord(gen), coord(gen), coord(gen)};
+  };
+  auto same = [](const Vector3D<T>& a, const Vector3D<T>& b) {
+    return a.x_ == b.x_ && a.y_ == b.y_ && a.z_ == b.z_;
+  };
+  for (int i = 0; i < 1000; ++i) {
+    auto a = random(), b = random();
+    Packed pa(a), pb(b);
+    ASSERT_TRUE(same((pa - pb).unpack(), a - b));
+    // scalar products may be contracted to fused multiply-adds
+    auto bound = 8 * std::numeric_limits<T>::epsilon() * a.norm() * b.norm();
+    auto cross_err = crossProduct(pa, pb).unpack() - crossProduct(a, b);
+    ASSERT_LE(cross_err.norm(), bound);
+    ASSERT_LE(std::abs(dot(pa, pb) - dot(a, b)), bound);
+    auto unit_err = Packed(a).normalize().unpack() - Vector3D(a).normalize();
+    ASSERT_LE(unit_err.norm(), 4 * std::numeric_limits<T>::epsilon());
+    ASSERT_EQ(pa.isClose(pb), a.isClose(b));
+    auto near = a + Vector3D<T>{0, 0, comparator::kAbsTol<T> / 2};
+    ASSERT_EQ(pa.isClose(Packed(near)), a.isClose(near));
+    ASSERT_TRUE(pa.isClose(pa));
+  }
+  ASSERT_FALSE(Packed().valid());
+  ASSERT_FALSE(Packed(Vector3D<T>{1, INFINITY, 0}).valid());
+  ASSERT_TRUE(Packed::nullVector().valid());
+  ASSERT_TRUE(collinear(Packed(Vector3D<T>{1, 2, 3}),
+                        Packed(Vector3D<T>{-2, -4, -6})));
+}
+
+TEST(PackedVector3D, MatchesScalar) {
+  checkPackedMatchesScalar<float, simd::Xyz<float>>();
+  checkPackedMatchesScalar<double, simd::Xyz<double>>();
+  checkPackedMatchesScalar<float, simd::ScalarXyz<float>>();
+  checkPackedMatchesScalar<double, simd::ScalarXyz<double>>();
+#if defined(__SSE2__)
+  checkPackedMatchesScalar<double, simd::SseDoubleXyz>();
+#endif
+}
+
+TEST(PackedVector3D, Alignment) {
+  static_assert(alignof(PackedVector3D<float>) == 16);
+  static_assert(alignof(PackedVector3D<double>) == 32);
+  static_assert(sizeof(PackedVector3D<float>) == 16);
+  Vector3D<float> a{0, 0, 0}, b{1, 0, 0}, c{0, 1, 0};
+  Plane<float> plane{PackedVector3D<float>(a), PackedVector3D<float>(b),
+                     PackedVector3D<float>(c)};
+  ASSERT_TRUE(plane.normal().isClose({0, 0, 1}));
+  ASSERT_TRUE(plane.isClose(Plane<float>(a, b, c)));
+}
+
 TEST(Line3D, isClose) {
   Line3D<double> l1{{0, 0, 1}, {7, 8, 9}};
   Line3D<double> l2{{0, 0, -10000}, {7, 8, 9}};
@@ -549,12 +626,1014 @@ TEST(Triangle3D, Intersects_DegenerateSegment_CollinearOutside) {
   ASSERT_FALSE(normal.intersects(segment));
 }
 
+TEST(Triangle3D, Contains_MatchesAreaTest) {
+  Triangle3D<double> t{{1.0, 0.0, 0.0}, {0.0, 2.0, 1.0}, {-1.0, -1.0, 2.0}};
+  for (auto v : {t.a_, t.b_, t.c_, (t.a_ + t.b_) * 0.5, (t.b_ + t.c_) * 0.5}) {
+    ASSERT_TRUE(t.contains(v));
+  }
+  ASSERT_FALSE(t.contains(t.a_ + crossProduct(t.b_ - t.a_, t.c_ - t.a_)));
+
+  std::mt19937 gen(13);
+  std::uniform_real_distribution<double> coef(-1.0, 2.0);
+  for (auto i = 0; i < 10000; ++i) {
+    // points of the plane, both inside and outside
+    auto u = coef(gen), v = coef(gen);
+    auto p = t.a_ + (t.b_ - t.a_) * u + (t.c_ - t.a_) * v;
+    ASSERT_EQ(t.contains(p), t.containsByArea(p));
+  }
+}
+
 TEST(Octree, Construction_FromEmptyRange) {
   std::vector<Triangle3D<double>> v;
   Octree<double> tree(v.begin(), v.end());
   ASSERT_TRUE(tree.getIntersections().empty());
 }
 
+namespace {
+
+std::vector<Triangle3D<double>> randomTriangles(std::size_t count,
+                                                std::uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> center_dst(0.0, 10.0);
+  std::uniform_real_distribution<double> offset_dst(-0.5, 0.5);
+
+  std::vector<Triangle3D<double>> res(count);
+  for (auto&& t : res) {
+    Vector3D<double> c{center_dst(rng), center_dst(rng), center_dst(rng)};
+    for (auto v : {&t.a_, &t.b_, &t.c_}) {
+      *v = c + Vector3D<double>{offset_dst(rng), offset_dst(rng),
+                                offset_dst(rng)};
+    }
+  }
+  return res;
+}
+
+/** triangles with coordinates converted to T, rounded if T is narrower */
+template <typename T, typename U>
+std::vector<Triangle3D<T>> convertTriangles(
+    const std::vector<Triangle3D<U>>& source) {
+  std::vector<Triangle3D<T>> res;
+  res.reserve(source.size());
+  for (auto&& t : source) {
+    res.push_back({{T(t.a_.x_), T(t.a_.y_), T(t.a_.z_)},
+                   {T(t.b_.x_), T(t.b_.y_), T(t.b_.z_)},
+                   {T(t.c_.x_), T(t.c_.y_), T(t.c_.z_)}});
+  }
+  return res;
+}
+
+}  // namespace
+
+TEST(FrameTracker, MatchesOctreeOnEveryFrame) {
+  auto triangles = randomTriangles(500, 1);
+  FrameTracker<double> tracker(triangles.begin(), triangles.end());
+  Octree<double> first(triangles.begin(), triangles.end());
+  ASSERT_EQ(tracker.getIntersections(), first.getIntersections());
+
+  std::mt19937_64 rng(2);
+  std::uniform_real_distribution<double> step_dst(-0.2, 0.2);
+  for (auto frame = 0; frame < 10; ++frame) {
+    for (std::size_t i = frame; i < triangles.size(); i += 7) {
+      Vector3D<double> step{step_dst(rng), step_dst(rng), step_dst(rng)};
+      auto&& t = triangles[i];
+      t = {t.a_ + step, t.b_ + step, t.c_ + step};
+    }
+    tracker.update(triangles.begin(), triangles.end());
+
+    Octree<double> octree(triangles.begin(), triangles.end());
+    ASSERT_EQ(tracker.getIntersections(), octree.getIntersections());
+  }
+}
+
+TEST(FrameTracker, StaticFrameRetestsNothing) {
+  auto triangles = randomTriangles(200, 3);
+  FrameTracker<double> tracker(triangles.begin(), triangles.end());
+  auto before = tracker.getIntersections();
+
+  tracker.update(triangles.begin(), triangles.end());
+  ASSERT_EQ(tracker.retested(), 0);
+  ASSERT_EQ(tracker.getIntersections(), before);
+}
+
+TEST(FrameTracker, TouchingWithinTolerance) {
+  // pairs along x, the second of each ends an ulp short of the first
+  std::vector<Triangle3D<double>> triangles;
+  for (auto k = 0; k < 100; ++k) {
+    double x = 10 * k + 8;
+    auto x1 = std::nextafter(x, -INFINITY);
+    triangles.push_back({{x, 0, 0}, {x + 1, 0, 1}, {x + 1, 0, -1}});
+    triangles.push_back({{x1, -1, 0}, {x1, 1, 0}, {x - 1, 0, 0}});
+  }
+  for (auto kernel : {NarrowPhase::kGeneric, NarrowPhase::kInterval}) {
+    FrameTracker<double> tracker(triangles.begin(), triangles.end(), kernel);
+    Octree<double> octree(triangles.begin(), triangles.end());
+    octree.setNarrowPhase(kernel);
+    ASSERT_EQ(tracker.getIntersections().size(), triangles.size());
+    ASSERT_EQ(tracker.getIntersections(), octree.getIntersections());
+  }
+}
+
+TEST(Octree, ParallelMatchesSequential) {
+  auto triangles = randomTriangles(2000, 4);
+  Octree<double> tree(triangles.begin(), triangles.end());
+  ASSERT_EQ(tree.getIntersections(4), tree.getIntersections());
+}
+
+TEST(BoundedQueue, ManyProducersAndConsumers) {
+  BoundedQueue<std::uint32_t> queue(5);
+  ASSERT_EQ(queue.capacity(), 8u);
+  std::uint32_t v;
+  ASSERT_FALSE(queue.tryPop(v));
+  for (std::uint32_t i = 0; i < 8; ++i) {
+    ASSERT_TRUE(queue.tryPush(i));
+  }
+  ASSERT_FALSE(queue.tryPush(8));
+  for (std::uint32_t i = 0; i < 8; ++i) {
+    ASSERT_TRUE(queue.tryPop(v));
+    ASSERT_EQ(v, i);
+  }
+
+  // every value pushed by producers is popped exactly once
+  constexpr std::uint32_t kValues = 20000;
+  std::vector<std::atomic<int>> popped(kValues);
+  std::atomic<std::uint32_t> consumed{0};
+  parallelFor(6, 6, [&](std::size_t k, unsigned) {
+    if (k < 3) {
+      for (auto i = static_cast<std::uint32_t>(k); i < kValues; i += 3) {
+        while (!queue.tryPush(i)) {
+          std::this_thread::yield();
+        }
+      }
+      return;
+    }
+    while (consumed.load() < kValues) {
+      std::uint32_t i;
+      if (queue.tryPop(i)) {
+        popped[i].fetch_add(1);
+        consumed.fetch_add(1);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  });
+  for (auto&& p : popped) {
+    ASSERT_EQ(p.load(), 1);
+  }
+}
+
+TEST(Octree, PipelineMatchesSequential) {
+  auto triangles = randomTriangles(2000, 4);
+  Octree<double> tree(triangles.begin(), triangles.end());
+  for (auto kernel : {NarrowPhase::kInterval, NarrowPhase::kGeneric}) {
+    tree.setNarrowPhase(kernel);
+    auto expected = tree.getIntersections();
+    auto components = tree.getComponents();
+    std::vector<std::pair<std::size_t, std::size_t>> pairs;
+    tree.forEachIntersectingPair([&pairs](auto i, auto j) {
+      pairs.emplace_back(std::min(i, j), std::max(i, j));
+    });
+    std::sort(pairs.begin(), pairs.end());
+
+    for (auto pipeline : {PipelineOptions{},
+                          PipelineOptions{.broad_threads = 3,
+                                          .narrow_threads = 2,
+                                          .batch_size = 7,
+                                          .queue_depth = 1},
+                          PipelineOptions{.broad_threads = 1,
+                                          .narrow_threads = 4,
+                                          .batch_size = 1,
+                                          .queue_depth = 3}}) {
+      ASSERT_EQ(tree.getIntersections(pipeline), expected);
+      ASSERT_EQ(tree.getComponents(pipeline), components);
+
+      std::mutex mutex;
+      std::vector<std::pair<std::size_t, std::size_t>> piped;
+      tree.forEachIntersectingPair(
+          [&](auto i, auto j) {
+            std::lock_guard lock(mutex);
+            piped.emplace_back(std::min(i, j), std::max(i, j));
+          },
+          pipeline);
+      std::sort(piped.begin(), piped.end());
+      ASSERT_EQ(piped, pairs);
+    }
+  }
+}
+
+TEST(ConcurrentUnionFind, Components) {
+  ConcurrentUnionFind uf(6);
+  uf.unite(4, 1);
+  uf.unite(5, 3);
+  uf.unite(3, 1);
+  ASSERT_TRUE(uf.connected(4, 5));
+  ASSERT_FALSE(uf.connected(0, 1));
+
+  auto components = uf.components();
+  ASSERT_EQ(components.size(), 1);
+  ASSERT_EQ(components.at(1), (std::vector<std::size_t>{1, 3, 4, 5}));
+}
+
+TEST(Octree, ComponentsMatchBruteForce) {
+  auto triangles = randomTriangles(300, 5);
+  Octree<double> tree(triangles.begin(), triangles.end());
+
+  ConcurrentUnionFind reference(triangles.size());
+  for (std::uint32_t i = 0; i < triangles.size(); ++i) {
+    for (auto j = i + 1; j < triangles.size(); ++j) {
+      if (triangles[i].intersects(triangles[j])) {
+        reference.unite(i, j);
+      }
+    }
+  }
+  ASSERT_EQ(tree.getComponents(4), reference.components());
+}
+
+TEST(Octree, AnytimeQuery_ZeroBudget) {
+  auto triangles = randomTriangles(500, 6);
+  Octree<double> tree(triangles.begin(), triangles.end());
+  auto query = tree.startQuery();
+
+  ASSERT_FALSE(query.run({.work = 0}));
+  ASSERT_TRUE(query.getIntersections().empty());
+  ASSERT_EQ(query.completeness(), 0.0);
+}
+
+TEST(Octree, AnytimeQuery_ResumesToFullAnswer) {
+  auto triangles = randomTriangles(3000, 7);
+  Octree<double> tree(triangles.begin(), triangles.end());
+  auto query = tree.startQuery();
+
+  auto steps = 0;
+  auto completeness = 0.0;
+  while (!query.run({.work = 5000})) {
+    ASSERT_GT(query.completeness(), completeness);
+    ASSERT_LT(query.completeness(), 1.0);
+    completeness = query.completeness();
+    ++steps;
+  }
+  ASSERT_GT(steps, 1);
+  ASSERT_EQ(query.completeness(), 1.0);
+  ASSERT_EQ(query.getIntersections(), tree.getIntersections());
+}
+
+TEST(NarrowPhase, IntervalMatchesGeneric) {
+  auto triangles = randomTriangles(400, 9);
+  auto floats = convertTriangles<float>(triangles);
+
+  for (std::size_t i = 0; i < triangles.size(); ++i) {
+    for (auto j = i + 1; j < triangles.size(); ++j) {
+      ASSERT_EQ(intersectsInterval(triangles[i], triangles[j]),
+                triangles[i].intersects(triangles[j]));
+      ASSERT_EQ(intersectsInterval(floats[i], floats[j]),
+                floats[i].intersects(floats[j]));
+    }
+  }
+}
+
+TEST(NarrowPhase, IntervalMatchesCGAL) {
+  auto triangles = randomTriangles(200, 10);
+  auto toCGAL = [](const Triangle3D<double>& t) {
+    return Triangle_3(Point_3(t.a_.x_, t.a_.y_, t.a_.z_),
+                      Point_3(t.b_.x_, t.b_.y_, t.b_.z_),
+                      Point_3(t.c_.x_, t.c_.y_, t.c_.z_));
+  };
+
+  for (std::size_t i = 0; i < triangles.size(); ++i) {
+    for (auto j = i + 1; j < triangles.size(); ++j) {
+      ASSERT_EQ(intersectsInterval(triangles[i], triangles[j]),
+                CGAL::do_intersect(toCGAL(triangles[i]), toCGAL(triangles[j])));
+    }
+  }
+}
+
+TEST(NarrowPhase, IntervalTouchingAndCoplanar) {
+  Triangle3D<double> t{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}};
+  Triangle3D<double> vertex_touch{{1, 0, 0}, {2, 0, 1}, {2, 1, 1}};
+  Triangle3D<double> edge_touch{{0.5, 0.5, 0}, {1, 1, 1}, {1, 1, -1}};
+  Triangle3D<double> coplanar{{0.2, 0.2, 0}, {2, 0.2, 0}, {0.2, 2, 0}};
+  Triangle3D<double> coplanar_apart{{2, 2, 0}, {3, 2, 0}, {2, 3, 0}};
+  Triangle3D<double> above{{0, 0, 1e-3}, {1, 0, 1e-3}, {0, 1, 1}};
+
+  for (auto&& other :
+       {vertex_touch, edge_touch, coplanar, coplanar_apart, above}) {
+    ASSERT_EQ(intersectsInterval(t, other), t.intersects(other));
+    ASSERT_EQ(intersects(other, t, NarrowPhase::kInterval),
+              intersects(other, t, NarrowPhase::kGeneric));
+  }
+  ASSERT_TRUE(intersectsInterval(t, vertex_touch));
+  ASSERT_TRUE(intersectsInterval(t, coplanar));
+  ASSERT_FALSE(intersectsInterval(t, above));
+}
+
+TEST(NarrowPhase, MixedMatchesDouble) {
+  auto triangles = randomTriangles(300, 12);
+  auto floats = convertTriangles<float>(triangles);
+  auto widened = convertTriangles<double>(floats);
+
+  for (std::size_t i = 0; i < floats.size(); ++i) {
+    for (auto j = i + 1; j < floats.size(); ++j) {
+      auto expected = widened[i].intersects(widened[j]);
+      ASSERT_EQ(intersectsMixed(floats[i], floats[j]), expected);
+      ASSERT_EQ(intersects(PreparedTriangle<float>(floats[i]),
+                           PreparedTriangle<float>(floats[j]),
+                           NarrowPhase::kMixed),
+                expected);
+    }
+  }
+
+  // float tolerance takes one ulp gap for contact, double one does not
+  auto z = std::nextafter(100.f, 200.f);
+  Triangle3D<float> t{{0, 0, 100}, {1, 0, 100}, {0, 1, 100}};
+  Triangle3D<float> above{{0, 0, z}, {1, 0, z}, {0, 1, z}};
+  ASSERT_TRUE(t.intersects(above));
+  ASSERT_FALSE(intersectsMixed(t, above));
+}
+
+TEST(Predicates, NearlyCollinearPoints) {
+  // naive evaluation gets signs wrong on this grid, see Kettner et al.
+  // "Classroom examples of robustness problems in geometric computations"
+  predicates::Point2D<double> q{12, 12}, r{24, 24};
+  auto ulp = std::ldexp(1.0, -53);
+  for (auto i = 0; i < 32; ++i) {
+    for (auto j = 0; j < 32; ++j) {
+      predicates::Point2D<double> p{0.5 + i * ulp, 0.5 + j * ulp};
+      auto expected = (j > i) - (j < i);  // sign of 12 * (py - px)
+      ASSERT_EQ(predicates::orient2d(p, q, r), expected);
+      ASSERT_EQ(predicates::orient3d(Vector3D<double>{p[0], p[1], 0},
+                                     Vector3D<double>{q[0], q[1], 0},
+                                     Vector3D<double>{r[0], r[1], 0},
+                                     Vector3D<double>{0, 0, 1}),
+                -expected);
+    }
+  }
+  ASSERT_TRUE(predicates::collinear(Vector3D<double>{0.5, 0.5, 0.5},
+                                    Vector3D<double>{12, 12, 12},
+                                    Vector3D<double>{24, 24, 24}));
+}
+
+TEST(NarrowPhase, ExactMatchesCGAL) {
+  auto triangles = randomTriangles(200, 11);
+  auto toCGAL = [](const Triangle3D<double>& t) {
+    return Triangle_3(Point_3(t.a_.x_, t.a_.y_, t.a_.z_),
+                      Point_3(t.b_.x_, t.b_.y_, t.b_.z_),
+                      Point_3(t.c_.x_, t.c_.y_, t.c_.z_));
+  };
+
+  for (std::size_t i = 0; i < triangles.size(); ++i) {
+    PreparedTriangle<double> prepared(triangles[i]);
+    for (auto j = i + 1; j < triangles.size(); ++j) {
+      auto expected =
+          CGAL::do_intersect(toCGAL(triangles[i]), toCGAL(triangles[j]));
+      ASSERT_EQ(intersectsExact(triangles[i], triangles[j]), expected);
+      ASSERT_EQ(intersectsExact(prepared,
+                                PreparedTriangle<double>(triangles[j])),
+                expected);
+    }
+  }
+}
+
+TEST(NarrowPhase, ExactTouchingAndCoplanar) {
+  Triangle3D<double> t{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}};
+  Triangle3D<double> vertex_touch{{1, 0, 0}, {2, 0, 1}, {2, 1, 1}};
+  Triangle3D<double> edge_touch{{0.5, 0.5, 0}, {1, 1, 1}, {1, 1, -1}};
+  Triangle3D<double> coplanar{{0.2, 0.2, 0}, {2, 0.2, 0}, {0.2, 2, 0}};
+  Triangle3D<double> coplanar_apart{{2, 2, 0}, {3, 2, 0}, {2, 3, 0}};
+  Triangle3D<double> segment{{0.2, 0.2, -1}, {0.2, 0.2, 0}, {0.2, 0.2, 1}};
+
+  ASSERT_TRUE(intersectsExact(t, vertex_touch));
+  ASSERT_TRUE(intersectsExact(t, edge_touch));
+  ASSERT_TRUE(intersectsExact(t, coplanar));
+  ASSERT_FALSE(intersectsExact(t, coplanar_apart));
+  ASSERT_TRUE(intersectsExact(t, segment));
+
+  // within tolerance of the generic kernel, apart in exact arithmetic
+  Triangle3D<double> parallel{{0, 0, 1e-12}, {1, 0, 1e-12}, {0, 1, 1e-12}};
+  ASSERT_TRUE(t.intersects(parallel));
+  ASSERT_FALSE(intersectsExact(t, parallel));
+  ASSERT_FALSE(intersects(t, parallel, NarrowPhase::kExact));
+}
+
+TEST(Predicates, IntegerMatchesDouble) {
+  std::mt19937_64 rng(14);
+  std::uniform_int_distribution<std::int32_t> dst(
+      std::numeric_limits<std::int32_t>::min(),
+      std::numeric_limits<std::int32_t>::max());
+  auto widen = [](const Vector3D<std::int32_t>& v) {
+    return Vector3D<double>{double(v.x_), double(v.y_), double(v.z_)};
+  };
+
+  for (auto i = 0; i < 10000; ++i) {
+    Vector3D<std::int32_t> v[4];
+    for (auto&& x : v) {
+      x = {dst(rng), dst(rng), dst(rng)};
+    }
+    if (i % 2 == 1) {
+      // fourth point on the plane of the first three, up to rounding
+      auto m = (double(v[0].z_) + v[1].z_ + v[2].z_) / 3;
+      v[3] = {std::int32_t((double(v[0].x_) + v[1].x_ + v[2].x_) / 3),
+              std::int32_t((double(v[0].y_) + v[1].y_ + v[2].y_) / 3),
+              std::int32_t(m)};
+    }
+    ASSERT_EQ(predicates::orient3d(v[0], v[1], v[2], v[3]),
+              predicates::orient3d(widen(v[0]), widen(v[1]), widen(v[2]),
+                                   widen(v[3])));
+    auto xy = [](const Vector3D<std::int32_t>& p) {
+      return predicates::Point2D<std::int32_t>{p.x_, p.y_};
+    };
+    auto wide_xy = [](const Vector3D<std::int32_t>& p) {
+      return predicates::Point2D<double>{double(p.x_), double(p.y_)};
+    };
+    ASSERT_EQ(predicates::orient2d(xy(v[0]), xy(v[1]), xy(v[3])),
+              predicates::orient2d(wide_xy(v[0]), wide_xy(v[1]),
+                                   wide_xy(v[3])));
+  }
+}
+
+template <typename T>
+void checkExactDegenerate() {
+  using Triangle = Triangle3D<T>;
+  Triangle t{{0, 0, 0}, {4, 0, 0}, {0, 4, 0}};
+  Triangle segment{{0, 0, 2}, {0, 0, 4}, {0, 0, 6}};
+  Triangle point{{0, 0, 6}, {0, 0, 6}, {0, 0, 6}};
+
+  // segment and point against a proper triangle
+  ASSERT_TRUE(intersectsExact(t, Triangle{{1, 1, -1}, {1, 1, 0}, {1, 1, 1}}));
+  ASSERT_TRUE(intersectsExact(t, Triangle{{2, 2, 1}, {2, 2, 0}, {2, 2, -1}}));
+  ASSERT_FALSE(intersectsExact(t, Triangle{{3, 3, 1}, {3, 3, 0}, {3, 3, -1}}));
+  ASSERT_TRUE(intersectsExact(t, Triangle{{-1, 1, 0}, {1, 1, 0}, {5, 1, 0}}));
+  ASSERT_FALSE(intersectsExact(t, Triangle{{5, 1, 0}, {6, 1, 0}, {7, 1, 0}}));
+  ASSERT_FALSE(intersectsExact(t, Triangle{{1, 1, 1}, {2, 1, 1}, {3, 1, 1}}));
+  ASSERT_TRUE(intersectsExact(t, Triangle{{1, 1, 0}, {1, 1, 0}, {1, 1, 0}}));
+  ASSERT_FALSE(intersectsExact(t, Triangle{{3, 3, 0}, {3, 3, 0}, {3, 3, 0}}));
+
+  // segments and points among themselves
+  ASSERT_TRUE(intersectsExact(segment, point));
+  ASSERT_TRUE(intersectsExact(point, point));
+  ASSERT_FALSE(
+      intersectsExact(point, Triangle{{0, 0, 7}, {0, 0, 7}, {0, 0, 7}}));
+  ASSERT_TRUE(
+      intersectsExact(segment, Triangle{{0, 0, 5}, {0, 0, 9}, {0, 0, 8}}));
+  ASSERT_FALSE(
+      intersectsExact(segment, Triangle{{0, 0, 7}, {0, 0, 9}, {0, 0, 8}}));
+  ASSERT_TRUE(
+      intersectsExact(segment, Triangle{{-1, 0, 3}, {1, 0, 3}, {3, 0, 3}}));
+  ASSERT_FALSE(
+      intersectsExact(segment, Triangle{{-1, 1, 3}, {1, 1, 3}, {3, 1, 3}}));
+}
+
+TEST(NarrowPhase, ExactDegenerateTriangles) {
+  checkExactDegenerate<float>();
+  checkExactDegenerate<double>();
+  checkExactDegenerate<std::int32_t>();
+}
+
+TEST(NarrowPhase, ExactIntegerMatchesDouble) {
+  std::mt19937_64 rng(15);
+  std::uniform_int_distribution<std::int32_t> dst(0, 3);
+  auto widen = [](const Triangle3D<std::int32_t>& t) {
+    auto v = [](const Vector3D<std::int32_t>& p) {
+      return Vector3D<double>{double(p.x_), double(p.y_), double(p.z_)};
+    };
+    return Triangle3D<double>{v(t.a_), v(t.b_), v(t.c_)};
+  };
+
+  // a small grid makes touching, coplanar and degenerate pairs common
+  for (auto i = 0; i < 20000; ++i) {
+    Triangle3D<std::int32_t> t[2];
+    for (auto&& tr : t) {
+      for (auto v : {&tr.a_, &tr.b_, &tr.c_}) {
+        *v = {dst(rng), dst(rng), dst(rng)};
+      }
+    }
+    auto expected = intersectsExact(widen(t[0]), widen(t[1]));
+    ASSERT_EQ(intersectsExact(t[0], t[1]), expected);
+    ASSERT_EQ(intersectsExact(t[1], t[0]), expected);
+  }
+}
+
+TEST(NarrowPhase, AdjacentTriangles) {
+  using V = Vector3D<double>;
+  auto prepared = [](const V& a, const V& b, const V& c, VertexIds ids) {
+    PreparedTriangle<double> t(Triangle3D<double>{a, b, c});
+    t.vertices_ = ids;
+    return t;
+  };
+  // every kernel agrees, the answer does not depend on the order either
+  auto check = [](const auto& t1, const auto& t2, bool expected) {
+    for (auto kernel : {NarrowPhase::kGeneric, NarrowPhase::kInterval,
+                        NarrowPhase::kExact, NarrowPhase::kMixed}) {
+      ASSERT_EQ(intersects(t1, t2, kernel), expected);
+      ASSERT_EQ(intersects(t2, t1, kernel), expected);
+    }
+  };
+  V o{0, 0, 0}, x{3, 0, 0}, y{0, 3, 0};
+  auto base = prepared(o, x, y, {0, 1, 2});
+
+  // common edge: hinge, flat neighbour and fold
+  check(base, prepared(x, o, {0, 0, 1}, {1, 0, 3}), false);
+  check(base, prepared(o, x, {1, -1, 0}, {0, 1, 3}), false);
+  check(base, prepared(x, {1, 1, 0}, o, {1, 3, 0}), true);
+
+  // common vertex: pierced, touching at the vertex only, flat neighbours
+  check(base, prepared({1, 1, -1}, o, {1, 1, 1}, {3, 0, 4}), true);
+  check(base, prepared({-1, -1, -1}, {-1, -1, 1}, o, {3, 4, 0}), false);
+  check(base, prepared(o, {-1, 0, 0}, {0, -1, 0}, {0, 3, 4}), false);
+  check(base, prepared(o, {1, 1, 0}, {2, 1, 0}, {0, 3, 4}), true);
+  // common ray on opposite sides of it
+  check(base, prepared(o, {4, 0, 0}, {1, -1, 0}, {0, 3, 4}), true);
+
+  // same vertices, no common ids and a degenerate triangle
+  ASSERT_EQ(intersectsAdjacent(base, prepared(o, x, y, {2, 1, 0})), true);
+  ASSERT_FALSE(intersectsAdjacent(
+                   base, prepared(x, o, {0, 0, 1}, {5, 6, 7}))
+                   .has_value());
+  ASSERT_FALSE(intersectsAdjacent(
+                   base, prepared(o, {1, 0, 0}, {2, 0, 0}, {0, 3, 4}))
+                   .has_value());
+  PreparedTriangle<double> soup(Triangle3D<double>{x, o, {0, 0, 1}});
+  ASSERT_FALSE(intersectsAdjacent(base, soup).has_value());
+}
+
+TEST(Octree, MeshMode) {
+  // cube with faces split into four triangles around their centres
+  using V = Vector3D<double>;
+  std::vector<Triangle3D<double>> mesh;
+  for (auto axis = 0; axis < 3; ++axis) {
+    for (auto side : {0.0, 2.0}) {
+      auto point = [axis, side](double u, double v) {
+        return axis == 0   ? V{side, u, v}
+               : axis == 1 ? V{v, side, u}
+                           : V{u, v, side};
+      };
+      V corners[4] = {point(0, 0), point(2, 0), point(2, 2), point(0, 2)};
+      for (auto i = 0; i < 4; ++i) {
+        mesh.push_back({point(1, 1), corners[i], corners[(i + 1) % 4]});
+      }
+    }
+  }
+  auto ids = weldVertices(mesh.begin(), mesh.end());
+  ASSERT_EQ(ids[0][0], ids[1][0]);
+  ASSERT_EQ(ids[0][2], ids[1][1]);
+
+  Octree<double> soup(mesh.begin(), mesh.end());
+  ASSERT_EQ(soup.getIntersections().size(), mesh.size());
+  for (auto kernel : {NarrowPhase::kGeneric, NarrowPhase::kExact}) {
+    Octree<double> closed(weldMesh(mesh.begin(), mesh.end()));
+    closed.setNarrowPhase(kernel);
+    ASSERT_TRUE(closed.getIntersections().empty());
+  }
+
+  // a fold over the first face and a triangle through the top
+  auto fold = mesh[0];
+  mesh.push_back({fold.b_, fold.c_, (fold.a_ + fold.b_) / 2.0});
+  mesh.push_back({{0.5, 0.5, 1}, {1.5, 0.5, 3}, {0.5, 1.5, 3}});
+  Octree<double> folded(weldMesh(mesh.begin(), mesh.end()));
+  auto hits = folded.getIntersections();
+  ASSERT_TRUE(hits.count(0) && hits.count(24) && hits.count(25));
+  ASSERT_LT(hits.size(), 8);
+}
+
+TEST(IndexedMesh, Weld) {
+  std::vector<Triangle3D<double>> soup = {{{0, 0, 0}, {1, 0, 0}, {0, 1, 0}},
+                                          {{1, 0, 0}, {1, 1, 0}, {0, 1, 0}},
+                                          {{0, 0, NAN}, {1, 0, 0}, {0, 1, 0}}};
+  auto mesh = weldMesh(soup.begin(), soup.end());
+  ASSERT_TRUE(mesh.valid());
+  ASSERT_EQ(mesh.size(), soup.size());
+  ASSERT_EQ(mesh.vertices_.size(), 5);
+  for (std::size_t i = 0; i < 2; ++i) {
+    ASSERT_TRUE(mesh[i].a_.isClose(soup[i].a_));
+    ASSERT_TRUE(mesh[i].b_.isClose(soup[i].b_));
+    ASSERT_TRUE(mesh[i].c_.isClose(soup[i].c_));
+  }
+
+  mesh.faces_.push_back({0, 1, 5});
+  ASSERT_FALSE(mesh.valid());
+}
+
+TEST(Duplicates, ExpandsToAllTriangles) {
+  using Tr = Triangle3D<double>;
+  Tr lying{{0, 0, 0}, {2, 0, 0}, {0, 2, 0}};
+  Tr standing{{0.5, 0.5, -1}, {0.5, 0.5, 1}, {1, 1, 1}};
+  Tr apart{{5, 5, 0}, {6, 5, 0}, {5, -0.0, 0}};
+  Tr near{{5, 5, 1e-9}, {5, 0, 0}, {6, 5, 0}};
+  std::vector<Tr> scene = {lying, apart,    {lying.b_, lying.c_, lying.a_},
+                           standing,        {{0, 0, NAN}, {1, 0, 0}, {0, 1, 0}},
+                           {{0, 0, NAN}, {1, 0, 0}, {0, 1, 0}},
+                           {{9, 9, 9}, {9, 9, 9}, {9, 9, 9}},
+                           {apart.c_, apart.b_, {5, 5, 0}}, near};
+
+  auto duplicates = findDuplicates(scene.begin(), scene.end());
+  ASSERT_EQ(duplicates.representatives(),
+            (std::vector<std::size_t>{0, 1, 3, 4, 5, 6, 8}));
+  std::vector<Tr> unique;
+  for (auto i : duplicates.representatives()) {
+    unique.push_back(scene[i]);
+  }
+  Octree<double> all(scene.begin(), scene.end());
+  Octree<double> reps(unique.begin(), unique.end());
+  ASSERT_EQ(duplicates.expand(reps.getIntersections()),
+            all.getIntersections());
+  ASSERT_EQ(duplicates.expand(reps.getComponents()), all.getComponents());
+
+  auto snapped = findDuplicates(scene.begin(), scene.end(), 1e-6);
+  ASSERT_EQ(snapped.representatives(),
+            (std::vector<std::size_t>{0, 1, 3, 4, 5, 6}));
+}
+
+TEST(Duplicates, SnappedMembersMayBeApart) {
+  using Tr = Triangle3D<double>;
+  // one group with step 1, only the last one touches the first
+  std::vector<Tr> scene = {{{0, 0, 0.1}, {2, 0, 0.1}, {0, 2, 0.1}},
+                           {{0, 0, 0.4}, {2, 0, 0.4}, {0, 2, 0.4}},
+                           {{0, 0, 0.1}, {2, 0, 0.1}, {0, 2, 0.1 + 1e-9}}};
+  auto duplicates = findDuplicates(scene.begin(), scene.end(), 1);
+  ASSERT_EQ(duplicates.representatives(), (std::vector<std::size_t>{0}));
+  duplicates.checkMembers([&scene](auto m, auto r) {
+    return scene[m].intersects(scene[r]);
+  });
+
+  Octree<double> all(scene.begin(), scene.end());
+  Octree<double> reps(scene.begin(), scene.begin() + 1);
+  ASSERT_EQ(duplicates.expand(reps.getIntersections()),
+            (std::set<std::size_t>{0, 2}));
+  ASSERT_EQ(duplicates.expand(reps.getIntersections()),
+            all.getIntersections());
+  ASSERT_EQ(duplicates.expand(reps.getComponents()), all.getComponents());
+
+  // members take the answer of their representative
+  ASSERT_EQ(duplicates.expand(std::set<std::size_t>{0}),
+            (std::set<std::size_t>{0, 1, 2}));
+}
+
+TEST(IntersectionSegment, CrossingTouchingCoplanar) {
+  using P = PreparedTriangle<double>;
+  P lying({{0, 0, 0}, {2, 0, 0}, {0, 2, 0}});
+  P standing({{0.5, 0.5, -1}, {0.5, 0.5, 1}, {1.5, 0.5, 0}});
+  auto s = intersectionSegment(lying, standing);
+  ASSERT_TRUE(s);
+  // direction follows normals, so ends come in any order
+  if (s->begin_.x_ > s->end_.x_) {
+    std::swap(s->begin_, s->end_);
+  }
+  ASSERT_TRUE(s->begin_.isClose({0.5, 0.5, 0}));
+  ASSERT_TRUE(s->end_.isClose({1.5, 0.5, 0}));
+
+  // cut of the standing one is longer, only part inside the lying one counts
+  P wide({{-1, 0.5, -1}, {-1, 0.5, 1}, {3, 0.5, 0}});
+  auto cut = intersectionSegment(lying, wide);
+  ASSERT_TRUE(cut);
+  auto ends = std::minmax(cut->begin_.x_, cut->end_.x_);
+  ASSERT_NEAR(ends.first, 0, 1e-12);
+  ASSERT_NEAR(ends.second, 1.5, 1e-12);
+
+  P touching({{1, 1, 0}, {1, 1, 1}, {2, 2, 1}});
+  auto point = intersectionSegment(lying, touching);
+  ASSERT_TRUE(point);
+  ASSERT_TRUE(point->begin_.isClose({1, 1, 0}));
+  ASSERT_TRUE(point->end_.isClose({1, 1, 0}));
+
+  P coplanar({{1, 1, 0}, {3, 1, 0}, {1, 3, 0}});
+  P apart({{5, 5, -1}, {5, 5, 1}, {6, 5, 0}});
+  P segment({{0.5, 0.5, -1}, {0.5, 0.5, 0}, {0.5, 0.5, 1}});
+  ASSERT_FALSE(intersectionSegment(lying, coplanar));
+  ASSERT_FALSE(intersectionSegment(lying, apart));
+  ASSERT_FALSE(intersectionSegment(lying, segment));
+}
+
+TEST(IntersectionSegment, ParallelExtractionMatchesSerial) {
+  auto triangles = randomTriangles(4000, 14);
+  Octree<double> tree(triangles.begin(), triangles.end());
+  std::vector<std::pair<std::size_t, std::size_t>> pairs;
+  tree.forEachIntersectingPair([&pairs](auto i, auto j) {
+    pairs.emplace_back(std::min(i, j), std::max(i, j));
+  });
+  std::sort(pairs.begin(), pairs.end());
+  ASSERT_GT(pairs.size(), 256u);
+
+  SegmentBuffer<double> serial, parallel;
+  auto prepared = tree.preparedByIndex();
+  extractSegments(prepared, pairs, serial);
+  extractSegments(prepared, pairs, parallel, 4);
+  ASSERT_GT(serial.size(), 0u);
+  ASSERT_EQ(serial.size(), parallel.size());
+  for (std::size_t k = 0; k < serial.size(); ++k) {
+    ASSERT_EQ(serial.first()[k], parallel.first()[k]);
+    ASSERT_EQ(serial.second()[k], parallel.second()[k]);
+    for (auto l = 0; l < SegmentBuffer<double>::kLanes; ++l) {
+      auto lane = static_cast<SegmentBuffer<double>::Lane>(l);
+      ASSERT_EQ(serial.lane(lane)[k], parallel.lane(lane)[k]);
+    }
+  }
+}
+
+TEST(IntersectionSegment, WeldsPolylines) {
+  // the first triangle cuts a fan of four triangles around the z axis into
+  // a loop and a strip of two triangles into an open chain
+  std::vector<Triangle3D<double>> triangles = {
+      {{-10, -10, 0.5}, {10, -10, 0.5}, {0, 10, 0.5}},
+      {{0, 0, 1}, {2, 0, -1}, {0, 2, -1}},
+      {{0, 0, 1}, {0, 2, -1}, {-2, 0, -1}},
+      {{0, 0, 1}, {-2, 0, -1}, {0, -2, -1}},
+      {{0, 0, 1}, {0, -2, -1}, {2, 0, -1}},
+      {{3, -3, -1}, {3, -1, -1}, {3, -3, 1}},
+      {{3, -1, -1}, {3, -1, 1}, {3, -3, 1}},
+  };
+  std::vector<std::pair<std::size_t, std::size_t>> pairs;
+  for (std::size_t j = 1; j < triangles.size(); ++j) {
+    pairs.emplace_back(0, j);
+  }
+  Octree<double> tree(triangles.begin(), triangles.end());
+  SegmentBuffer<double> segments;
+  extractSegments(tree.preparedByIndex(), pairs, segments);
+  ASSERT_EQ(segments.size(), 6u);
+
+  auto polylines = weldPolylines(segments);
+  ASSERT_EQ(polylines.size(), 2u);
+  std::vector<std::size_t> sizes;
+  for (std::size_t i = 0; i < polylines.size(); ++i) {
+    auto begin = polylines.offsets_[i], end = polylines.offsets_[i + 1];
+    sizes.push_back(end - begin);
+    auto&& first = polylines.points_[begin];
+    auto&& last = polylines.points_[end - 1];
+    ASSERT_EQ(end - begin == 5, first.isClose(last));
+  }
+  std::sort(sizes.begin(), sizes.end());
+  ASSERT_EQ(sizes, (std::vector<std::size_t>{3, 5}));
+}
+
+TEST(PreparedTriangle, Classification) {
+  PreparedTriangle<double> proper({{0, 0, 0}, {1, 0, 0}, {0, 0, 1}});
+  ASSERT_EQ(proper.degeneracy_, Degeneracy::kNone);
+  ASSERT_EQ(proper.dominant_axis_, 1);
+  ASSERT_TRUE(proper.plane_.valid());
+
+  PreparedTriangle<double> segment({{0, 0, 0}, {1, 1, 1}, {2, 2, 2}});
+  ASSERT_EQ(segment.degeneracy_, Degeneracy::kSegment);
+
+  PreparedTriangle<double> point({{1, 2, 3}, {1, 2, 3}, {1, 2, 3}});
+  ASSERT_EQ(point.degeneracy_, Degeneracy::kPoint);
+  ASSERT_EQ(point.scale_, 3);
+}
+
+TEST(PreparedTriangle, KernelsMatchPlainTriangles) {
+  auto triangles = randomTriangles(200, 12);
+  triangles.push_back({{1, 1, 1}, {2, 2, 2}, {3, 3, 3}});
+  triangles.push_back({{2, 2, 2}, {2, 2, 2}, {2, 2, 2}});
+  std::vector<PreparedTriangle<double>> prepared(triangles.begin(),
+                                                 triangles.end());
+
+  for (std::size_t i = 0; i < triangles.size(); ++i) {
+    for (auto j = i + 1; j < triangles.size(); ++j) {
+      auto expected = triangles[i].intersects(triangles[j]);
+      ASSERT_EQ(intersectsGeneric(prepared[i], prepared[j]), expected);
+      ASSERT_EQ(intersectsInterval(prepared[i], prepared[j]), expected);
+    }
+  }
+}
+
+TEST(PreparedTriangle, CoplanarGroupsAndDegenerateKernels) {
+  // three triangles on the floor z = 0, one above it and one crossing it,
+  // then segments and points on the floor, crossing it and in the air
+  std::vector<Triangle3D<double>> triangles = {
+      {{0, 0, 0}, {2, 0, 0}, {0, 2, 0}},
+      {{1, 1, 0}, {3, 1, 0}, {1, 3, 0}},
+      {{5, 5, 0}, {6, 5, 0}, {5, 6, 0}},
+      {{0, 0, 1}, {2, 0, 1}, {0, 2, 1}},
+      {{1, 0, -1}, {1, 0, 1}, {1, 1, 1}},
+      {{0.5, 0.5, -1}, {0.5, 0.5, 0}, {0.5, 0.5, 1}},
+      {{0, 1, 0}, {1, 2, 0}, {2, 3, 0}},
+      {{0.5, 0.5, 0}, {0.5, 0.5, 0}, {0.5, 0.5, 0}},
+      {{0.5, 0.5, 0}, {0.5, 0.5, 0}, {0.5, 0.5, 0}},
+      {{4, 4, 4}, {4, 4, 4}, {4, 4, 4}},
+  };
+  std::vector<PreparedTriangle<double>> prepared(triangles.begin(),
+                                                 triangles.end());
+  assignCoplanarGroups(prepared.begin(), prepared.end(),
+                       [](auto& t) -> auto& { return t; });
+
+  ASSERT_NE(prepared[0].coplanar_group_, PreparedTriangle<double>::kNoGroup);
+  ASSERT_TRUE(prepared[0].coplanarWith(prepared[1]));
+  ASSERT_TRUE(prepared[0].coplanarWith(prepared[2]));
+  ASSERT_FALSE(prepared[0].coplanarWith(prepared[3]));
+  ASSERT_FALSE(prepared[0].coplanarWith(prepared[4]));
+  ASSERT_FALSE(prepared[6].coplanarWith(prepared[6]));  // no plane
+  ASSERT_EQ(prepared[5].degeneracy_, Degeneracy::kSegment);
+  ASSERT_EQ(prepared[7].degeneracy_, Degeneracy::kPoint);
+
+  for (std::size_t i = 0; i < triangles.size(); ++i) {
+    for (std::size_t j = 0; j < triangles.size(); ++j) {
+      ASSERT_EQ(intersectsGeneric(prepared[i], prepared[j]),
+                triangles[i].intersects(triangles[j]));
+    }
+  }
+}
+
+TEST(PreparedTriangle, CoplanarKernelMatchesGeneric) {
+  std::mt19937_64 rng(13);
+  std::uniform_real_distribution<double> dst(-1.0, 1.0);
+  auto random = [&] { return Vector3D<double>{dst(rng), dst(rng), dst(rng)}; };
+
+  for (auto i = 0; i < 2000; ++i) {
+    // random plane, every third pair touches at a vertex or an edge midpoint
+    auto origin = random() * 10.0, u = random(), v = random();
+    Vector3D<double> p[6];
+    for (auto&& x : p) {
+      x = origin + u * dst(rng) + v * dst(rng);
+    }
+    if (i % 3 == 1) {
+      p[3] = p[0];
+    } else if (i % 3 == 2) {
+      p[3] = (p[0] + p[1]) / 2.0;
+    }
+    Triangle3D<double> t1{p[0], p[1], p[2]}, t2{p[3], p[4], p[5]};
+    PreparedTriangle<double> p1(t1), p2(t2);
+    ASSERT_TRUE(p1.plane_.isClose(p2.plane_));
+    ASSERT_EQ(intersectsGeneric(p1, p2), t1.intersects(t2));
+    ASSERT_EQ(intersectsGeneric(p2, p1), t1.intersects(t2));
+  }
+}
+
+/** V of void checks kernels dispatched at runtime */
+template <typename T, typename V = void>
+void checkBatchKernel() {
+  auto triangles = convertTriangles<T>(randomTriangles(300, 11));
+  TriangleBatch<T> batch;
+  batch.assign(triangles.begin(), triangles.end(),
+               [](const auto& t) -> auto& { return t; });
+  ASSERT_EQ(batch.size(), triangles.size());
+
+  std::size_t candidates = 0;
+  for (std::size_t i = 0; i < triangles.size(); ++i) {
+    std::vector<std::size_t> hits;
+    auto f = [&](auto k) {
+      ++candidates;
+      if (intersectsInterval(triangles[i], batch[k])) {
+        hits.push_back(k);
+      }
+    };
+    if constexpr (std::is_void_v<V>) {
+      batch.forEachCandidate(PreparedTriangle<T>(triangles[i]), i + 1, f);
+    } else {
+      batch.template forEachCandidate<V>(triangles[i], i + 1, f);
+    }
+
+    std::vector<std::size_t> expected;
+    for (auto j = i + 1; j < triangles.size(); ++j) {
+      if (intersectsInterval(triangles[i], triangles[j])) {
+        expected.push_back(j);
+      }
+    }
+    ASSERT_EQ(hits, expected);
+  }
+  // most pairs of small scattered triangles end in registers
+  ASSERT_LT(candidates, triangles.size() * triangles.size() / 20);
+}
+
+TEST(TriangleBatch, MatchesScalarKernel) {
+  checkBatchKernel<float, simd::Scalar<float>>();
+  checkBatchKernel<double, simd::Scalar<double>>();
+  checkBatchKernel<float, simd::Native<float>>();
+  checkBatchKernel<double, simd::Native<double>>();
+}
+
+TEST(Dispatch, EverySupportedIsaMatches) {
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<std::uint16_t> coord(0, 1000);
+  std::uniform_int_distribution<std::uint16_t> dim(0, 100);
+  // not a multiple of the block, so the tail is masked
+  std::vector<QuantizedBox> boxes(301);
+  for (auto&& b : boxes) {
+    for (auto a = 0; a < 3; ++a) {
+      b.min_[a] = coord(gen);
+      b.max_[a] = b.min_[a] + dim(gen);
+    }
+  }
+  QuantizedBoxes soa;
+  soa.assign(boxes.begin(), boxes.end(), [](auto& b) { return b; });
+
+  ASSERT_TRUE(simd::supported(simd::Isa::kBaseline));
+  ASSERT_TRUE(simd::supported(simd::bestIsa()));
+  for (auto isa : {simd::Isa::kBaseline, simd::Isa::kAvx2,
+                   simd::Isa::kAvx512}) {
+    if (!simd::setIsa(isa)) {
+      ASSERT_NE(isa, simd::Isa::kBaseline);
+      continue;
+    }
+    ASSERT_EQ(simd::activeIsa(), isa);
+    checkBatchKernel<float>();
+    checkBatchKernel<double>();
+    for (std::size_t i = 0; i < boxes.size(); ++i) {
+      std::vector<std::size_t> hits, expected;
+      soa.forEachOverlapping(boxes[i], 0,
+                             [&hits](auto k) { hits.push_back(k); });
+      for (std::size_t j = 0; j < boxes.size(); ++j) {
+        if (boxes[i].overlaps(boxes[j])) {
+          expected.push_back(j);
+        }
+      }
+      ASSERT_EQ(hits, expected);
+    }
+  }
+  simd::setIsa(simd::bestIsa());
+}
+
+TEST(QuantizedBox, Conservative) {
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> coord(-20, 20);
+  std::uniform_real_distribution<float> dim(0, 3);
+  auto random = [&] {
+    auto x = coord(gen), y = coord(gen), z = coord(gen);
+    return Range3D<float>{x, x + dim(gen), y, y + dim(gen), z, z + dim(gen)};
+  };
+  // ranges stick out of bounds and get clamped
+  BoxQuantizer<float> grid({-10, 10, -10, 10, -10, 10});
+  std::vector<Range3D<float>> ranges(500);
+  std::generate(ranges.begin(), ranges.end(), random);
+  std::vector<QuantizedBox> boxes;
+  for (auto&& r : ranges) {
+    boxes.push_back(grid(r));
+  }
+  QuantizedBoxes soa;
+  soa.assign(boxes.begin(), boxes.end(), [](auto& b) { return b; });
+
+  std::size_t rejected = 0;
+  for (std::size_t i = 0; i < ranges.size(); ++i) {
+    std::vector<std::size_t> hits;
+    soa.forEachOverlapping(boxes[i], 0, [&hits](auto k) { hits.push_back(k); });
+    std::vector<std::size_t> expected;
+    for (std::size_t j = 0; j < ranges.size(); ++j) {
+      auto&& a = ranges[i];
+      auto&& b = ranges[j];
+      auto overlap = a.min_x_ <= b.max_x_ && b.min_x_ <= a.max_x_ &&
+                     a.min_y_ <= b.max_y_ && b.min_y_ <= a.max_y_ &&
+                     a.min_z_ <= b.max_z_ && b.min_z_ <= a.max_z_;
+      ASSERT_TRUE(!overlap || boxes[i].overlaps(boxes[j]));
+      if (boxes[i].overlaps(boxes[j])) {
+        expected.push_back(j);
+      } else {
+        ++rejected;
+      }
+    }
+    ASSERT_EQ(hits, expected);
+  }
+  ASSERT_GT(rejected, ranges.size() * ranges.size() / 2);
+}
+
+TEST(QuantizedBox, DegenerateBounds) {
+  Range3D<float> r{1, 2, 1, 2, 1, 2};
+  Range3D<float> far{5, 6, 5, 6, 5, 6};
+  // flat bounds put everything in one cell along the axis
+  BoxQuantizer<float> flat({0, 10, 3, 3, 0, 10});
+  ASSERT_FALSE(flat(r).overlaps(flat(far)));
+  ASSERT_TRUE(flat(r).overlaps(flat({1, 2, 7, 8, 1, 2})));
+  // NaN spans whole axis
+  BoxQuantizer<float> grid({0, 10, 0, 10, 0, 10});
+  ASSERT_TRUE(grid({NAN, NAN, 5, 6, 5, 6}).overlaps(grid(far)));
+  // margin grows the box before rounding
+  ASSERT_FALSE(grid(r).overlaps(grid({2.5, 3, 1, 2, 1, 2})));
+  ASSERT_TRUE(grid(r, 0.3f).overlaps(grid({2.5, 3, 1, 2, 1, 2}, 0.3f)));
+}
+
+namespace {
+
+/** counts every heap allocation of the test binary */
+std::atomic<std::size_t> allocations{0};
+
+}  // namespace
+
+// kept out of line, otherwise GCC matches malloc() and free() inside them
+// against operator new and delete at call sites
+[[gnu::noinline]] void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+TEST(Octree, Query_NoAllocationsInSteadyState) {
+  auto triangles = randomTriangles(3000, 8);
+  Octree<double> tree(triangles.begin(), triangles.end());
+
+  Octree<double>::Scratch scratch;
+  std::vector<std::size_t> res;
+  tree.getIntersections(res, scratch);  // warm up buffers
+
+  auto before = allocations.load();
+  tree.getIntersections(res, scratch);
+  ASSERT_EQ(allocations.load(), before);
+
+  auto expected = tree.getIntersections();
+  ASSERT_FALSE(expected.empty());
+  ASSERT_EQ(std::set<std::size_t>(res.begin(), res.end()), expected);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();